@@ -0,0 +1,46 @@
+#include "backlight.h"
+
+static const backlight_profile_t presets[BACKLIGHT_PROFILES] = {
+    { LCD_BACKLIGHT_FULL,     LCD_BACKLIGHT_FULL, 0  }, // BACKLIGHT_PROFILE_ALWAYS_ON
+    { LCD_BACKLIGHT_FULL,     LCD_BACKLIGHT_OFF,  30 }, // BACKLIGHT_PROFILE_IDLE_OFF
+    { LCD_BACKLIGHT_FULL,     4,                  15 }, // BACKLIGHT_PROFILE_DIM
+    { LCD_BACKLIGHT_FULL / 2, LCD_BACKLIGHT_OFF,  10 }, // BACKLIGHT_PROFILE_SAVER
+};
+
+static backlight_profile_t profile;
+static volatile uint8_t idle_seconds = 0;
+
+void configure_backlight(void) {
+    backlight_select_profile(BACKLIGHT_DEFAULT_PROFILE);
+}
+
+bool backlight_select_profile(uint8_t index) {
+    if (index >= BACKLIGHT_PROFILES) {
+        return false;
+    }
+    return backlight_set_profile(&presets[index]);
+}
+
+bool backlight_set_profile(const backlight_profile_t* new_profile) {
+    if (new_profile->active_level > LCD_BACKLIGHT_FULL || new_profile->idle_level > LCD_BACKLIGHT_FULL) {
+        return false;
+    }
+    profile = *new_profile;
+    backlight_activity();
+    return true;
+}
+
+void backlight_activity(void) {
+    idle_seconds = 0;
+    lcd_set_backlight_level(profile.active_level);
+}
+
+// Called before the tick redraws the counter, so going idle rides on that write
+void backlight_countdown_tick(void) {
+    if (profile.idle_timeout_s == 0 || idle_seconds >= profile.idle_timeout_s) {
+        return;
+    }
+    if (++idle_seconds == profile.idle_timeout_s) {
+        lcd_set_backlight_level(profile.idle_level);
+    }
+}
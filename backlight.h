@@ -0,0 +1,32 @@
+#ifndef BACKLIGHT_H
+#define BACKLIGHT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lcd_display.h"
+
+// Backlight power profiles: full brightness (or active_level) while the user is
+// interacting, idle_level once a countdown has run idle_timeout_s seconds without an
+// IR key or a phase change.
+
+#define BACKLIGHT_PROFILE_ALWAYS_ON 0
+#define BACKLIGHT_PROFILE_IDLE_OFF  1   // Off 30s into a countdown
+#define BACKLIGHT_PROFILE_DIM       2   // 25% 15s into a countdown (PWM: at least ~55uA of CPU and I2C, see README)
+#define BACKLIGHT_PROFILE_SAVER     3   // 50% while active, off 10s into a countdown
+#define BACKLIGHT_PROFILES          4
+#define BACKLIGHT_DEFAULT_PROFILE   BACKLIGHT_PROFILE_IDLE_OFF
+
+typedef struct {
+    uint8_t active_level;               // LCD_BACKLIGHT_OFF..LCD_BACKLIGHT_FULL
+    uint8_t idle_level;
+    uint8_t idle_timeout_s;             // 0 never idles
+} backlight_profile_t;
+
+void configure_backlight(void);
+bool backlight_select_profile(uint8_t profile);
+bool backlight_set_profile(const backlight_profile_t* profile);
+void backlight_activity(void);          // IR key or phase change: back to active_level
+void backlight_countdown_tick(void);    // Once per second while a countdown runs
+
+#endif
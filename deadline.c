@@ -0,0 +1,182 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "deadline.h"
+#include "timebase.h"
+
+#define FAULT_MAGIC 0xDEAD
+
+static const uint16_t budgets[DEADLINE_SOURCES] = {
+    0,                                  // DEADLINE_USCI_B0
+    DEADLINE_TIMER0_A0_BUDGET_US,
+    DEADLINE_TIMER1_A1_BUDGET_US,
+    0,                                  // DEADLINE_PORT1
+    0,                                  // DEADLINE_USCI_A1
+    DEADLINE_TIMER2_A1_BUDGET_US,
+};
+
+static deadline_stats_t stats[DEADLINE_SOURCES];
+
+static uint8_t current = DEADLINE_NONE; // ISR running now (they don't nest)
+static uint32_t current_entry = 0;
+static uint32_t last_exit[DEADLINE_SOURCES]; // When each ISR last finished, and how long it ran:
+static uint16_t last_run[DEADLINE_SOURCES]; // the blocker is picked from these
+static uint16_t worst_run[DEADLINE_SOURCES]; // Run times in timebase ticks, converted to us when read
+
+// Kept across resets: the startup code doesn't zero it, the checksum tells it apart from garbage
+#pragma NOINIT(fault)
+static deadline_fault_t fault;
+
+static uint16_t fault_checksum(void) {
+    const uint8_t* bytes = (const uint8_t*)&fault;
+    uint16_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < offsetof(deadline_fault_t, checksum); i++) {
+        sum = (sum << 1 | sum >> 15) + bytes[i];
+    }
+    return sum;
+}
+
+static void seal_fault(void) {
+    fault.checksum = fault_checksum();
+}
+
+// The longest ISR that finished while the late event was waiting and ran at least as long as
+// the miss went over budget; anything shorter can't explain it, so the main loop held the CPU
+static uint8_t find_blocker(uint16_t latency_us, uint16_t budget_us) {
+    uint32_t waited = (uint32_t)latency_us * 512 / 15625; // us to timebase ticks
+    uint32_t event = current_entry - waited;
+    uint16_t longest = ((uint32_t)(latency_us - budget_us) * 512 + 15624) / 15625; // Rounded up: never 0
+    uint8_t blocker = DEADLINE_MAIN;
+    uint8_t source;
+
+    for (source = 0; source < DEADLINE_SOURCES; source++) {
+        if (source == current || stats[source].entries == 0) {
+            continue;
+        }
+        if ((int32_t)(last_exit[source] - event) > 0 && last_run[source] >= longest) {
+            longest = last_run[source];
+            blocker = source;
+        }
+    }
+    return blocker;
+}
+
+static uint16_t ticks_to_us(uint32_t ticks) {
+    uint32_t us;
+
+    if (ticks > 0xFFFF) {
+        return 0xFFFF;
+    }
+    us = DEADLINE_ACLK_US(ticks);
+    return us > 0xFFFF ? 0xFFFF : (uint16_t)us;
+}
+
+void configure_deadline(void) {
+    uint16_t cause;
+    bool watchdog = false;
+
+    while ((cause = SYSRSTIV) != SYSRSTIV_NONE) { // Reading pops the highest-priority reset cause
+        if (cause == SYSRSTIV_WDTTO || cause == SYSRSTIV_WDTKEY) {
+            watchdog = true;
+        }
+    }
+
+    if (fault.magic != FAULT_MAGIC || fault.checksum != fault_checksum()) {
+        memset(&fault, 0, sizeof(fault));
+        fault.magic = FAULT_MAGIC;
+        fault.source = DEADLINE_NONE;
+        fault.blocker = DEADLINE_NONE;
+    }
+    fault.boots++;
+    if (watchdog) {
+        fault.watchdog_resets++;
+    }
+    seal_fault();
+
+    WDTCTL = DEADLINE_WATCHDOG_CONFIG;
+}
+
+void deadline_isr_enter(uint8_t source, uint32_t now) {
+    current = source;
+    current_entry = now;
+    stats[source].entries++;
+}
+
+void deadline_check(uint32_t latency_us) {
+    deadline_stats_t* s = &stats[current];
+    uint16_t latency = latency_us > 0xFFFF ? 0xFFFF : (uint16_t)latency_us;
+
+    if (latency > s->worst_latency_us) {
+        s->worst_latency_us = latency;
+    }
+    if (budgets[current] == 0 || latency <= budgets[current]) {
+        return;
+    }
+
+    s->misses++;
+    if (fault.source == DEADLINE_NONE) {
+        fault.source = current;
+        fault.latency_us = latency;
+        fault.budget_us = budgets[current];
+        fault.blocker = find_blocker(latency, budgets[current]);
+        fault.blocker_run_us = fault.blocker == DEADLINE_MAIN ? 0 : ticks_to_us(last_run[fault.blocker]);
+        fault.at = current_entry;
+        fault.boot = fault.boots;
+        seal_fault();
+    }
+}
+
+void deadline_isr_exit(uint32_t now) {
+    uint32_t run = now - current_entry;
+
+    last_exit[current] = now;
+    last_run[current] = run > 0xFFFF ? 0xFFFF : (uint16_t)run;
+    if (last_run[current] > worst_run[current]) {
+        worst_run[current] = last_run[current];
+    }
+    current = DEADLINE_NONE;
+}
+
+void deadline_kick(void) {
+    WDTCTL = DEADLINE_WATCHDOG_CONFIG;
+}
+
+bool deadline_get_stats(uint8_t source, uint16_t* budget_us, deadline_stats_t* out) {
+    unsigned short interrupt_state;
+
+    if (source >= DEADLINE_SOURCES) {
+        return false;
+    }
+    interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    *budget_us = budgets[source];
+    *out = stats[source];
+    out->worst_run_us = ticks_to_us(worst_run[source]);
+    __set_interrupt_state(interrupt_state);
+    return true;
+}
+
+void deadline_get_fault(deadline_fault_t* out) {
+    unsigned short interrupt_state = __get_interrupt_state();
+
+    __disable_interrupt();
+    *out = fault;
+    __set_interrupt_state(interrupt_state);
+}
+
+void deadline_clear_fault(void) {
+    unsigned short interrupt_state = __get_interrupt_state();
+
+    __disable_interrupt();
+    fault.source = DEADLINE_NONE;
+    fault.blocker = DEADLINE_NONE;
+    fault.latency_us = 0;
+    fault.budget_us = 0;
+    fault.blocker_run_us = 0;
+    fault.at = 0;
+    fault.boot = 0;
+    seal_fault();
+    __set_interrupt_state(interrupt_state);
+}
@@ -0,0 +1,68 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// ISR deadline monitor: each interrupt whose hardware timestamps its event (timer
+// compares, IR captures) checks on entry how long the event waited against a latency
+// budget. The first miss is captured in a no-init RAM fault record that survives resets,
+// and the hardware watchdog is fed only from the main loop.
+
+// One source per interrupt vector
+#define DEADLINE_USCI_B0    0
+#define DEADLINE_TIMER0_A0  1
+#define DEADLINE_TIMER1_A1  2
+#define DEADLINE_PORT1      3
+#define DEADLINE_USCI_A1    4
+#define DEADLINE_TIMER2_A1  5
+#define DEADLINE_SOURCES    6
+#define DEADLINE_MAIN       0xFE    // Blocker: main loop running with interrupts disabled
+#define DEADLINE_NONE       0xFF
+
+// Latency budgets in us, 0 for vectors without a hardware timestamp to check against
+#define DEADLINE_TIMER0_A0_BUDGET_US    50000   // 1Hz countdown: a late tick only shifts the display
+#define DEADLINE_TIMER1_A1_BUDGET_US    560     // IR capture: half a NEC '0' bit before the next edge
+#define DEADLINE_TIMER2_A1_BUDGET_US    4000    // Bus backoff and backlight PWM edges
+
+#define DEADLINE_LOST       0xFFFF  // Latency of an event that was overwritten before its ISR ran
+
+// Timer ticks to us (ACLK 32768Hz, SMCLK ~1.048576MHz)
+#define DEADLINE_ACLK_US(ticks)     ((uint32_t)(uint16_t)(ticks) * 15625UL >> 9)
+#define DEADLINE_SMCLK_US(ticks)    ((uint32_t)(uint16_t)(ticks) * 15625UL >> 14)
+
+// Watchdog: ACLK / 512K = 16s without a kick from the main loop resets the MCU
+#define DEADLINE_WATCHDOG_CONFIG    (WDTPW | WDTSSEL_1 | WDTCNTCL | WDTIS_3)
+
+typedef struct {
+    uint32_t entries;
+    uint16_t misses;
+    uint16_t worst_latency_us;
+    uint16_t worst_run_us;              // Timebase resolution (~31us)
+} deadline_stats_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t source;                     // Late interrupt, DEADLINE_NONE until the first miss
+    uint8_t blocker;                    // Longest ISR that ran while the event waited, or DEADLINE_MAIN
+    uint16_t latency_us;
+    uint16_t budget_us;
+    uint16_t blocker_run_us;            // How long the blocking ISR ran in total
+    uint32_t at;                        // Timebase ticks since the boot that captured it
+    uint16_t boot;                      // Which boot captured it
+    uint16_t boots;                     // Resets since the record was created
+    uint16_t watchdog_resets;
+    uint16_t checksum;
+} deadline_fault_t;
+
+void configure_deadline(void);          // Before interrupts are enabled; arms the watchdog
+void deadline_isr_enter(uint8_t source, uint32_t now); // timebase_now() taken by the ISR, shared with
+void deadline_check(uint32_t latency_us);               // the energy hooks
+void deadline_isr_exit(uint32_t now);
+void deadline_kick(void);               // Main loop only
+bool deadline_get_stats(uint8_t source, uint16_t* budget_us, deadline_stats_t* stats);
+void deadline_get_fault(deadline_fault_t* fault);
+void deadline_clear_fault(void);        // Arms capture of the next miss; reset counters are kept
+
+#endif
@@ -0,0 +1,184 @@
+#include <string.h>
+
+#include "energy.h"
+#include "timebase.h"
+
+#define LOAD_BIT(channel) (1u << (channel))
+
+static uint16_t model[ENERGY_MODEL_SIZE] = {
+    ENERGY_DEFAULT_ACTIVE_UA,
+    ENERGY_DEFAULT_LPM0_UA,
+    ENERGY_DEFAULT_LPM1_UA,
+    ENERGY_DEFAULT_LPM2_UA,
+    ENERGY_DEFAULT_LPM3_UA,
+    ENERGY_DEFAULT_LPM4_UA,
+    ENERGY_DEFAULT_I2C_TX_UA,
+    ENERGY_DEFAULT_BUZZER_UA,
+    ENERGY_DEFAULT_BACKLIGHT_UA,
+    ENERGY_DEFAULT_BASELINE_UA,
+};
+
+static energy_residency_t current_cycle;
+static energy_residency_t last_cycle;
+static uint32_t cycle_start = 0;
+static uint16_t cycles = 0;
+
+static uint16_t loads_on = 0;                   // LOAD_BIT() of each load channel drawing current
+static uint32_t load_since[ENERGY_CHANNELS];
+
+static uint8_t sleep_channel = ENERGY_ACTIVE;   // LPM the main loop sleeps in, ENERGY_ACTIVE when awake
+static uint32_t sleep_since = 0;
+static uint32_t sleep_isr_mark = 0;
+
+static uint32_t isr_ticks = 0;                  // Time spent in ISRs, which isn't sleep time
+static uint32_t isr_entry = 0;
+static uint8_t in_isr = 0;
+
+static uint8_t lpm_channel(unsigned short lpm_bits) {
+    if (lpm_bits & OSCOFF) {
+        return ENERGY_LPM4;
+    }
+    if ((lpm_bits & (SCG1 | SCG0)) == (SCG1 | SCG0)) {
+        return ENERGY_LPM3;
+    }
+    if (lpm_bits & SCG1) {
+        return ENERGY_LPM2;
+    }
+    if (lpm_bits & SCG0) {
+        return ENERGY_LPM1;
+    }
+    return ENERGY_LPM0;
+}
+
+static uint32_t isr_time(uint32_t now) {
+    return isr_ticks + (in_isr ? now - isr_entry : 0);
+}
+
+// Moves the open sleep and load intervals into the current cycle. Interrupts disabled.
+static void close_intervals(uint32_t now) {
+    uint8_t channel;
+
+    if (sleep_channel != ENERGY_ACTIVE) {
+        uint32_t isr_now = isr_time(now);
+        current_cycle.ticks[sleep_channel] += (now - sleep_since) - (isr_now - sleep_isr_mark);
+        sleep_since = now;
+        sleep_isr_mark = isr_now;
+    }
+    for (channel = ENERGY_I2C_TX; channel < ENERGY_CHANNELS; channel++) {
+        if (loads_on & LOAD_BIT(channel)) {
+            current_cycle.ticks[channel] += now - load_since[channel];
+            load_since[channel] = now;
+        }
+    }
+}
+
+void configure_energy(void) {
+    memset(&current_cycle, 0, sizeof(current_cycle));
+    memset(&last_cycle, 0, sizeof(last_cycle));
+    cycle_start = timebase_now();
+}
+
+void energy_sleep(unsigned short lpm_bits) {
+    uint32_t now = timebase_now();
+
+    sleep_channel = lpm_channel(lpm_bits);
+    sleep_since = now;
+    sleep_isr_mark = isr_time(now);
+    __bis_SR_register(lpm_bits | GIE);
+
+    __disable_interrupt();
+    close_intervals(timebase_now());
+    sleep_channel = ENERGY_ACTIVE;
+    __enable_interrupt();
+}
+
+void energy_isr_enter(uint32_t now) {
+    isr_entry = now;
+    in_isr = 1;
+}
+
+void energy_isr_exit(uint32_t now) {
+    isr_ticks += now - isr_entry;
+    in_isr = 0;
+}
+
+void energy_set_load(uint8_t channel, bool on) {
+    unsigned short interrupt_state = __get_interrupt_state();
+    uint16_t bit = LOAD_BIT(channel);
+    uint32_t now;
+
+    __disable_interrupt();
+    now = timebase_now();
+    if (on && !(loads_on & bit)) {
+        load_since[channel] = now;
+        loads_on |= bit;
+    } else if (!on && (loads_on & bit)) {
+        current_cycle.ticks[channel] += now - load_since[channel];
+        loads_on &= ~bit;
+    }
+    __set_interrupt_state(interrupt_state);
+}
+
+void energy_cycle_start(void) {
+    unsigned short interrupt_state = __get_interrupt_state();
+    uint32_t now;
+
+    __disable_interrupt();
+    now = timebase_now();
+    close_intervals(now);
+    current_cycle.duration = now - cycle_start;
+    last_cycle = current_cycle;
+    memset(&current_cycle, 0, sizeof(current_cycle));
+    cycle_start = now;
+    cycles++;
+    __set_interrupt_state(interrupt_state);
+}
+
+uint16_t energy_cycle_count(void) {
+    return cycles;
+}
+
+void energy_get_cycle(uint8_t which, energy_residency_t* residency) {
+    unsigned short interrupt_state = __get_interrupt_state();
+    uint32_t sleeping = 0;
+    uint8_t channel;
+
+    __disable_interrupt();
+    if (which == ENERGY_CYCLE_CURRENT) {
+        uint32_t now = timebase_now();
+        close_intervals(now);
+        current_cycle.duration = now - cycle_start;
+        *residency = current_cycle;
+    } else {
+        *residency = last_cycle;
+    }
+    __set_interrupt_state(interrupt_state);
+
+    for (channel = ENERGY_LPM0; channel <= ENERGY_LPM4; channel++) {
+        sleeping += residency->ticks[channel];
+    }
+    residency->ticks[ENERGY_ACTIVE] = residency->duration - sleeping;
+}
+
+bool energy_set_current(uint8_t channel, uint16_t microamps) {
+    if (channel >= ENERGY_MODEL_SIZE) {
+        return false;
+    }
+    model[channel] = microamps;
+    return true;
+}
+
+const uint16_t* energy_model(void) {
+    return model;
+}
+
+// Pure function of its arguments so the simulator can apply it to its own residency
+uint32_t energy_charge_nah(const energy_residency_t* residency, const uint16_t* current_model) {
+    uint64_t microamp_ticks = (uint64_t)residency->duration * current_model[ENERGY_BASELINE];
+    uint8_t channel;
+
+    for (channel = 0; channel < ENERGY_CHANNELS; channel++) {
+        microamp_ticks += (uint64_t)residency->ticks[channel] * current_model[channel];
+    }
+    return (uint32_t)(microamp_ticks * 1000 / (TIMEBASE_HZ * 3600UL));
+}
@@ -0,0 +1,58 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Energy accounting: residency of the CPU modes and of the big loads, in timebase ticks,
+// turned into charge by a per-channel current model. A cycle runs from one focus start
+// to the next.
+
+// Residency channels. CPU modes are exclusive; the loads overlap with them and each other.
+#define ENERGY_ACTIVE       0
+#define ENERGY_LPM0         1
+#define ENERGY_LPM1         2
+#define ENERGY_LPM2         3
+#define ENERGY_LPM3         4
+#define ENERGY_LPM4         5
+#define ENERGY_I2C_TX       6
+#define ENERGY_BUZZER       7
+#define ENERGY_BACKLIGHT    8
+#define ENERGY_CHANNELS     9
+#define ENERGY_BASELINE     ENERGY_CHANNELS // Model only: always drawn (LCD logic, IR receiver)
+#define ENERGY_MODEL_SIZE   (ENERGY_CHANNELS + 1)
+
+#define ENERGY_CYCLE_LAST       0
+#define ENERGY_CYCLE_CURRENT    1
+
+// Default current model in uA (MSP430F5529 at 1MHz DCO, 3.3V, 16x2 HD44780 backpack)
+#define ENERGY_DEFAULT_ACTIVE_UA        300
+#define ENERGY_DEFAULT_LPM0_UA          80
+#define ENERGY_DEFAULT_LPM1_UA          75
+#define ENERGY_DEFAULT_LPM2_UA          7
+#define ENERGY_DEFAULT_LPM3_UA          2
+#define ENERGY_DEFAULT_LPM4_UA          1
+#define ENERGY_DEFAULT_I2C_TX_UA        350     // Pull-ups held low + USCI
+#define ENERGY_DEFAULT_BUZZER_UA        25000
+#define ENERGY_DEFAULT_BACKLIGHT_UA     20000
+#define ENERGY_DEFAULT_BASELINE_UA      2000
+
+typedef struct {
+    uint32_t duration;                  // timebase ticks
+    uint32_t ticks[ENERGY_CHANNELS];    // ENERGY_ACTIVE is derived: duration minus the LPMs
+} energy_residency_t;
+
+void configure_energy(void);
+void energy_sleep(unsigned short lpm_bits); // Call with interrupts disabled; returns with them enabled
+void energy_isr_enter(uint32_t now);   // timebase_now() taken by the ISR, shared with the deadline hooks
+void energy_isr_exit(uint32_t now);
+void energy_set_load(uint8_t channel, bool on);
+void energy_cycle_start(void);
+uint16_t energy_cycle_count(void);
+void energy_get_cycle(uint8_t which, energy_residency_t* residency);
+bool energy_set_current(uint8_t channel, uint16_t microamps);
+const uint16_t* energy_model(void);
+uint32_t energy_charge_nah(const energy_residency_t* residency, const uint16_t* model);
+
+#endif
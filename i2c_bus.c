@@ -0,0 +1,291 @@
+#include "i2c_bus.h"
+#include "timebase.h"
+#include "energy.h"
+#include "deadline.h"
+
+#define BUS_IDLE    0
+#define BUS_ACTIVE  1
+
+typedef struct {
+    uint8_t address;
+    uint8_t backing_off;                // Head transaction NACKed, waiting for retry_at
+    uint32_t retry_at;
+    i2c_transaction_t* head;            // FIFO of pending transactions
+    i2c_transaction_t* tail;
+    i2c_device_stats_t stats;
+} i2c_device_t;
+
+static i2c_device_t devices[I2C_BUS_MAX_DEVICES];
+static uint8_t device_count = 0;
+
+static volatile uint8_t bus_state = BUS_IDLE;
+static uint8_t active_device = 0;       // Device owning the bus (also the round-robin position)
+static uint8_t tx_index = 0;
+static uint8_t completed = 0;           // Set when a synchronous transaction finishes: USCI_B0_ISR wakes the CPU
+
+static uint32_t busy_since = 0;         // Utilization: bus time between START and STOP
+static uint32_t busy_ticks = 0;
+static uint32_t configured_at = 0;
+
+void configure_i2c_bus(void) {
+    P3SEL |= BIT0 | BIT1;                     // Assign P3.0 to UCB0SDA and P3.1 to UCB0SCL
+    UCB0CTL1 |= UCSWRST;                      // Enable SW reset
+    UCB0CTL0 = UCMST + UCMODE_3 + UCSYNC;     // I2C Master, synchronous mode
+    UCB0CTL1 = UCSSEL_2 + UCSWRST;            // Use SMCLK, keep SW reset
+    UCB0BR0 = 12;                             // fSCL = SMCLK/12 = ~87kHz with SMCLK ~1.045MHz
+    UCB0BR1 = 0;
+    UCB0CTL1 &= ~UCSWRST;                     // Clear SW reset, resume operation
+    UCB0IE = UCTXIE | UCNACKIE;               // Bus is driven from USCI_B0_ISR
+
+    configured_at = timebase_now();
+}
+
+uint8_t i2c_bus_register(uint8_t address) {
+    i2c_device_t* device;
+
+    if (device_count >= I2C_BUS_MAX_DEVICES) {
+        return I2C_BUS_NO_DEVICE;
+    }
+    device = &devices[device_count];
+    device->address = address;
+    device->backing_off = 0;
+    device->head = 0;
+    device->tail = 0;
+    return device_count++;
+}
+
+static void end_busy(void) {
+    busy_ticks += timebase_now() - busy_since;
+    energy_set_load(ENERGY_I2C_TX, false);
+}
+
+// Picks the next device after the last one served that has work and isn't backing off.
+// Must run with interrupts disabled.
+static void start_next(void) {
+    uint32_t now;
+    int32_t wait;
+    int32_t shortest_wait = 0;
+    uint8_t i;
+    i2c_device_t* device;
+
+    if (bus_state != BUS_IDLE || device_count == 0) {
+        return;
+    }
+
+    now = timebase_now();
+    for (i = 1; i <= device_count; i++) {
+        uint8_t index = (active_device + i) % device_count;
+        device = &devices[index];
+        if (!device->head) {
+            continue;
+        }
+        if (device->backing_off) {
+            wait = (int32_t)(device->retry_at - now);
+            if (wait > 0) {
+                if (shortest_wait == 0 || wait < shortest_wait) {
+                    shortest_wait = wait;
+                }
+                continue;
+            }
+            device->backing_off = 0;
+        }
+
+        active_device = index;
+        tx_index = 0;
+        device->head->status = I2C_STATUS_ACTIVE;
+        device->head->attempts++;
+        bus_state = BUS_ACTIVE;
+        busy_since = now;
+        energy_set_load(ENERGY_I2C_TX, true);
+
+        while (UCB0CTL1 & UCTXSTP);           // Previous STOP still going out
+        UCB0I2CSA = device->address;
+        UCB0CTL1 |= UCTR + UCTXSTT;           // I2C TX, start condition
+        return;
+    }
+
+    if (shortest_wait > 0) {                  // Only backing-off devices left
+        timebase_set_alarm(TIMEBASE_ALARM_I2C_BACKOFF, shortest_wait > 0xFFFF ? 0xFFFF : (uint16_t)shortest_wait, start_next);
+    }
+}
+
+static void finish(i2c_device_t* device, uint8_t status) {
+    i2c_transaction_t* transaction = device->head;
+    i2c_callback_t on_complete = transaction->on_complete;
+    uint32_t latency = timebase_now() - transaction->queued_at;
+
+    device->head = transaction->next;
+    if (!device->head) {
+        device->tail = 0;
+    }
+
+    device->stats.transactions++;
+    device->stats.latency_total += latency;
+    if (latency > device->stats.latency_max) {
+        device->stats.latency_max = latency > 0xFFFF ? 0xFFFF : (uint16_t)latency;
+    }
+
+    transaction->status = status;             // The owner may reuse it from here on
+    if (on_complete) {
+        on_complete(transaction);
+    } else {
+        completed = 1;                        // i2c_bus_write() is sleeping on it
+    }
+}
+
+static void handle_nack(void) {
+    i2c_device_t* device = &devices[active_device];
+    i2c_transaction_t* transaction = device->head;
+
+    UCB0CTL1 |= UCTXSTP;                      // Release the bus
+    UCB0IFG &= ~(UCNACKIFG | UCTXIFG);
+    end_busy();
+    bus_state = BUS_IDLE;
+
+    device->stats.nacks++;
+    if (transaction->attempts > I2C_BUS_MAX_RETRIES) {
+        device->stats.failures++;
+        finish(device, I2C_STATUS_NACK);
+    } else {
+        transaction->status = I2C_STATUS_QUEUED;
+        device->backing_off = 1;
+        device->retry_at = timebase_now() + ((uint32_t)I2C_BUS_BACKOFF_TICKS << (transaction->attempts - 1));
+    }
+    start_next();
+}
+
+static void handle_tx(void) {
+    i2c_device_t* device = &devices[active_device];
+    i2c_transaction_t* transaction = device->head;
+
+    if (bus_state != BUS_ACTIVE) {
+        UCB0IFG &= ~UCTXIFG;                  // Nothing to send
+        return;
+    }
+    if (tx_index < transaction->length) {
+        UCB0TXBUF = transaction->data[tx_index++];
+        return;
+    }
+
+    UCB0CTL1 |= UCTXSTP;                      // Last byte is out: I2C stop condition
+    UCB0IFG &= ~UCTXIFG;
+    end_busy();
+    bus_state = BUS_IDLE;
+    finish(device, I2C_STATUS_DONE);
+    start_next();
+}
+
+bool i2c_bus_submit(uint8_t device, i2c_transaction_t* transaction) {
+    unsigned short interrupt_state;
+    i2c_device_t* target;
+
+    if (device >= device_count) {
+        return false;
+    }
+    target = &devices[device];
+
+    transaction->status = I2C_STATUS_QUEUED;
+    transaction->attempts = 0;
+    transaction->next = 0;
+    transaction->queued_at = timebase_now();
+
+    interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    if (target->tail) {
+        target->tail->next = transaction;
+    } else {
+        target->head = transaction;
+    }
+    target->tail = transaction;
+    start_next();
+    __set_interrupt_state(interrupt_state);
+    return true;
+}
+
+uint8_t i2c_bus_write(uint8_t device, const uint8_t* data, uint8_t length) {
+    i2c_transaction_t transaction;
+
+    transaction.data = data;
+    transaction.length = length;
+    transaction.on_complete = 0;
+    if (!i2c_bus_submit(device, &transaction)) {
+        return I2C_STATUS_NACK;
+    }
+
+    while (transaction.status < I2C_STATUS_DONE) {
+        if (__get_interrupt_state() & GIE) {
+            __disable_interrupt();
+            if (transaction.status < I2C_STATUS_DONE) {
+                energy_sleep(LPM0_bits);      // USCI_B0_ISR wakes us when it's done
+            }
+            __enable_interrupt();
+        } else {
+            i2c_bus_poll();                   // Called from an ISR: drive the bus ourselves
+        }
+    }
+    return transaction.status;
+}
+
+void i2c_bus_poll(void) {
+    timebase_poll();                          // Backoff alarms can't fire either
+    if (bus_state != BUS_ACTIVE) {
+        return;
+    }
+    if (UCB0IFG & UCNACKIFG) {
+        handle_nack();
+    } else if (UCB0IFG & UCTXIFG) {
+        handle_tx();
+    }
+}
+
+bool i2c_bus_get_stats(uint8_t device, uint8_t* address, i2c_device_stats_t* stats) {
+    unsigned short interrupt_state;
+
+    if (device >= device_count) {
+        return false;
+    }
+    interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    *address = devices[device].address;
+    *stats = devices[device].stats;
+    __set_interrupt_state(interrupt_state);
+    return true;
+}
+
+void i2c_bus_get_utilization(uint32_t* busy, uint32_t* elapsed) {
+    unsigned short interrupt_state = __get_interrupt_state();
+    uint32_t now;
+
+    __disable_interrupt();
+    now = timebase_now();
+    *busy = busy_ticks;
+    if (bus_state == BUS_ACTIVE) {
+        *busy += now - busy_since;            // Transaction in flight counts up to now
+    }
+    *elapsed = now - configured_at;
+    __set_interrupt_state(interrupt_state);
+}
+
+#pragma vector=USCI_B0_VECTOR
+__interrupt void USCI_B0_ISR(void) {
+    uint32_t now;
+
+    now = timebase_now();
+    energy_isr_enter(now);
+    deadline_isr_enter(DEADLINE_USCI_B0, now);
+    switch (__even_in_range(UCB0IV, 12)) {
+        case 4:                               // UCNACKIFG
+            handle_nack();
+            break;
+        case 12:                              // UCTXIFG
+            handle_tx();
+            break;
+    }
+    now = timebase_now();
+    deadline_isr_exit(now);
+    energy_isr_exit(now);
+    if (completed) {
+        completed = 0;
+        __bic_SR_register_on_exit(LPM0_bits); // Wake a synchronous caller
+    }
+}
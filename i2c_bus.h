@@ -0,0 +1,60 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// USCI_B0 I2C master shared by several devices: SDA -> P3.0 / SCL -> P3.1
+//
+// Each device has its own FIFO of transactions; the bus serves devices round-robin,
+// one transaction at a time, switching UCB0I2CSA per transaction. A NACK is retried
+// with exponential backoff while the other devices keep using the bus.
+//
+// Synchronous calls sleep in LPM0 until USCI_B0_ISR finishes them, or poll the bus
+// when called with interrupts disabled (from an ISR). An ISR that uses the synchronous
+// API may complete a transaction the main loop is sleeping on, so it must wake the CPU
+// on exit (__bic_SR_register_on_exit).
+
+#define I2C_BUS_MAX_DEVICES     4
+#define I2C_BUS_MAX_RETRIES     3
+#define I2C_BUS_BACKOFF_TICKS   33      // ~1ms in timebase ticks, doubled on every retry
+#define I2C_BUS_NO_DEVICE       0xFF
+
+#define I2C_STATUS_QUEUED       0
+#define I2C_STATUS_ACTIVE       1
+#define I2C_STATUS_DONE         2
+#define I2C_STATUS_NACK         3       // Gave up after I2C_BUS_MAX_RETRIES
+
+typedef struct i2c_transaction i2c_transaction_t;
+typedef void (*i2c_callback_t)(i2c_transaction_t* transaction);
+
+struct i2c_transaction {
+    const uint8_t* data;
+    uint8_t length;
+    volatile uint8_t status;
+    uint8_t attempts;
+    i2c_callback_t on_complete;         // Runs in interrupt context; 0 marks a synchronous caller to wake
+    uint32_t queued_at;                 // timebase ticks
+    i2c_transaction_t* next;
+};
+
+typedef struct {
+    uint32_t transactions;
+    uint16_t nacks;
+    uint16_t failures;
+    uint32_t latency_total;             // timebase ticks from submit to completion
+    uint16_t latency_max;
+} i2c_device_stats_t;
+
+void configure_i2c_bus(void);
+uint8_t i2c_bus_register(uint8_t address);
+bool i2c_bus_submit(uint8_t device, i2c_transaction_t* transaction);
+uint8_t i2c_bus_write(uint8_t device, const uint8_t* data, uint8_t length);
+void i2c_bus_poll(void);
+bool i2c_bus_get_stats(uint8_t device, uint8_t* address, i2c_device_stats_t* stats);
+// Bus time between START and STOP, and time since configure_i2c_bus(), both in timebase
+// ticks and never reset: utilization over a window is the ratio of two reads' differences
+void i2c_bus_get_utilization(uint32_t* busy, uint32_t* elapsed);
+
+#endif
@@ -1,48 +1,117 @@
+#include <string.h>
+
 #include "lcd_display.h"
+#include "i2c_bus.h"
+#include "energy.h"
+#include "timebase.h"
+
+#define LCD_CURSOR_UNKNOWN  0xFF // Address counter points to CGRAM (or hasn't been set yet)
+#define LCD_SHADOW_STALE    0x10 // Blank in the A00 ROM and never written: forces a cell rewrite
+#define GLYPH_NONE          0xFF
+
+// Custom glyphs that can be made resident in CGRAM on demand
+enum {
+    GLYPH_BIG_TOP,      // Upper bar of a big digit
+    GLYPH_BIG_BOTTOM,   // Lower bar of a big digit
+    GLYPH_BIG_BOTH,     // Upper bar + middle stroke of a big digit
+    GLYPH_BAR_1,        // Progress bar cell with 1..4 pixel columns filled
+    GLYPH_BAR_2,
+    GLYPH_BAR_3,
+    GLYPH_BAR_4,
+    GLYPH_COUNT
+};
+
+static const uint8_t glyph_patterns[GLYPH_COUNT][LCD_GLYPH_HEIGHT] = {
+    { 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F },
+    { 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F },
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+    { 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 },
+    { 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C },
+    { 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E },
+};
+
+// Big digits: top row cells followed by bottom row cells.
+// F = full block, T/B/M = GLYPH_BIG_TOP/BOTTOM/BOTH, ' ' = blank
+static const char big_digit_cells[10][2 * LCD_BIG_DIGIT_WIDTH] = {
+    "FTFFBF", // 0
+    "TF BFB", // 1
+    "MMFFBB", // 2
+    "TMFBBF", // 3
+    "FBF  F", // 4
+    "FMMBBF", // 5
+    "FMMFBF", // 6
+    "TTF  F", // 7
+    "FMFFBF", // 8
+    "FMFBBF", // 9
+};
 
 static uint8_t backlight_state = LCD_BL_BIT; // Default to backlight ON
+static uint8_t backlight_level = LCD_BACKLIGHT_FULL;
+static uint8_t wire_backlight = LCD_BL_BIT;    // BL bit the PCF8574 is driving (outputs come up high)
+static uint8_t pwm_running = 0;
+static uint8_t pwm_byte;
+static i2c_transaction_t pwm_transaction;
+static uint32_t i2c_write_count = 0;           // Profiling: PCF8574 writes issued
+static uint8_t lcd_device = I2C_BUS_NO_DEVICE;
 
-static void i2c_init_msp430(void) {
-    P3SEL |= BIT0 | BIT1;                     // Assign P3.0 to UCB0SDA and P3.1 to UCB0SCL
-    UCB0CTL1 |= UCSWRST;                      // Enable SW reset
-    UCB0CTL0 = UCMST + UCMODE_3 + UCSYNC;     // I2C Master, synchronous mode
-    UCB0CTL1 = UCSSEL_2 + UCSWRST;            // Use SMCLK, keep SW reset
-    UCB0BR0 = 12;                             // fSCL = SMCLK/12 = ~87kHz with SMCLK ~1.045MHz
-    UCB0BR1 = 0;
-    UCB0I2CSA = PCF8574_ADDR;                 // Set slave address
-    UCB0CTL1 &= ~UCSWRST;                     // Clear SW reset, resume operation
-}
+static uint8_t ddram_shadow[LCD_ROWS][LCD_COLS]; // What the panel currently shows
+static uint8_t cursor_addr = LCD_CURSOR_UNKNOWN; // Mirror of the HD44780 address counter
 
-static void i2c_write_byte(uint8_t slave_addr, uint8_t data) {
-    (void)slave_addr; // slave_addr is already set in UCB0I2CSA during init
-                      // If multiple slaves were on the bus, UCB0I2CSA would be updated here.
+static uint8_t cgram_slot_glyph[LCD_CGRAM_SLOTS];    // Glyph resident in each slot
+static uint16_t cgram_slot_last_use[LCD_CGRAM_SLOTS]; // For LRU eviction
+static uint16_t cgram_use_counter = 0;
 
-    while (UCB0CTL1 & UCTXSTP);             // Ensure stop condition got sent
-    UCB0CTL1 |= UCTR + UCTXSTT;             // I2C TX, start condition
-    while (!(UCB0IFG & UCTXIFG) && (UCB0CTL1 & UCTXSTT)); // Corrected UCTXIFG0 to UCTXIFG
-    if (UCB0IFG & UCNACKIFG) {              // Check for NACK
-        UCB0CTL1 |= UCTXSTP;                // Send STOP if NACK received
-        UCB0IFG &= ~UCNACKIFG;              // Clear NACK flag
-        return;                             // Exit on NACK
+static void note_wire_backlight(uint8_t pcf_byte) {
+    uint8_t bl = pcf_byte & LCD_BL_BIT;
+    if (bl != wire_backlight) {
+        wire_backlight = bl;
+        energy_set_load(ENERGY_BACKLIGHT, bl != 0);
     }
-    UCB0TXBUF = data;                       // Load data into buffer
-    while (!(UCB0IFG & UCTXIFG));           // Wait for TX to complete (UCBxTXBUF is empty again) [2] Corrected UCTXIFG0 to UCTXIFG
-    UCB0CTL1 |= UCTXSTP;                    // I2C stop condition
-    while(UCB0CTL1 & UCTXSTP);              // Ensure stop condition got sent
 }
 
-static void lcd_write_pcf8574(uint8_t pcf_byte) {
-    i2c_write_byte(PCF8574_ADDR, pcf_byte);
-    __delay_cycles(50); // Small delay for PCF8574 to process
+static void lcd_write_pcf8574(const uint8_t* pcf_bytes, uint8_t length) {
+    i2c_write_count += length;
+    i2c_bus_write(lcd_device, pcf_bytes, length); // PCF8574 latches each byte on its ACK
+    note_wire_backlight(pcf_bytes[length - 1]);
+}
+
+static void pwm_written(i2c_transaction_t* transaction) {
+    note_wire_backlight(*transaction->data);
+}
+
+// PWM edge, from TIMER2_A1_ISR: flips BL and writes it alone (E low, so the HD44780 ignores it)
+static void backlight_pwm_edge(void) {
+    uint16_t on_ticks = (uint16_t)backlight_level * (LCD_BACKLIGHT_PWM_PERIOD / LCD_BACKLIGHT_FULL);
+
+    if (backlight_level == LCD_BACKLIGHT_OFF || backlight_level == LCD_BACKLIGHT_FULL) {
+        pwm_running = 0;
+        return;
+    }
+    if (backlight_state) {
+        backlight_state = 0;
+        timebase_set_alarm(TIMEBASE_ALARM_BACKLIGHT, LCD_BACKLIGHT_PWM_PERIOD - on_ticks, backlight_pwm_edge);
+    } else {
+        backlight_state = LCD_BL_BIT;
+        timebase_set_alarm(TIMEBASE_ALARM_BACKLIGHT, on_ticks, backlight_pwm_edge);
+    }
+
+    pwm_byte = backlight_state;
+    if (pwm_transaction.status >= I2C_STATUS_DONE) { // Still queued: it'll send the new pwm_byte
+        pwm_transaction.data = &pwm_byte;
+        pwm_transaction.length = 1;
+        pwm_transaction.on_complete = pwm_written;
+        i2c_write_count++;
+        i2c_bus_submit(lcd_device, &pwm_transaction);
+    }
 }
 
 static void lcd_pulse_enable(uint8_t data_with_rs_bl_and_data) {
-    lcd_write_pcf8574(data_with_rs_bl_and_data | LCD_EN_BIT); // E = 1 (high)
-    __delay_cycles(50); // Enable pulse width (min 450ns for HD44780)
-                       // At 1MHz, 50 cycles = 50us, which is ample.
-    lcd_write_pcf8574(data_with_rs_bl_and_data & ~LCD_EN_BIT); // E = 0 (low)
+    uint8_t pulse[2];
+    pulse[0] = data_with_rs_bl_and_data | LCD_EN_BIT;  // E = 1 (high)
+    pulse[1] = data_with_rs_bl_and_data & ~LCD_EN_BIT; // E = 0 (low), one byte time (~100us) later
+    lcd_write_pcf8574(pulse, 2);                       // Both edges in a single transaction
     __delay_cycles(100); // Execution time for most commands (min 37us)
-                        // Using 100us provides a safe margin.
 }
 
 static void lcd_write_nibble(uint8_t nibble, uint8_t rs_mode) {
@@ -57,7 +126,14 @@ static void lcd_write_nibble(uint8_t nibble, uint8_t rs_mode) {
 }
 
 void configure_lcd(void) {
-    i2c_init_msp430();
+    uint8_t slot;
+    for (slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+        cgram_slot_glyph[slot] = GLYPH_NONE; // CGRAM content is undefined at power-up
+    }
+
+    lcd_device = i2c_bus_register(PCF8574_ADDR); // Bus must be configured by the caller
+    pwm_transaction.status = I2C_STATUS_DONE;
+    energy_set_load(ENERGY_BACKLIGHT, wire_backlight != 0);
     __delay_cycles(50000); // Wait >40ms after VCC rises to 2.7V (HD44780 spec)
                            // Using 50ms at 1MHz for safety.
 
@@ -80,7 +156,7 @@ void configure_lcd(void) {
 
     backlight_state = LCD_BL_BIT; // Store state for subsequent writes
     uint8_t current_pcf_val_for_backlight_only = backlight_state; // RS=0, E=0, Data=0, R/W=0 (implicitly)
-    lcd_write_pcf8574(current_pcf_val_for_backlight_only); // Update backlight immediately
+    lcd_write_pcf8574(&current_pcf_val_for_backlight_only, 1); // Update backlight immediately
 }
 
 void lcd_send_command(uint8_t command) {
@@ -90,11 +166,36 @@ void lcd_send_command(uint8_t command) {
         __delay_cycles(2000); // These commands need >1.52ms [3]
                               // 2000 cycles at 1MHz = 2ms
     }
+
+    // Keep the shadow copies in sync with what the controller now holds
+    if (command & LCD_SET_DDRAM_ADDR) {
+        cursor_addr = command & 0x7F;
+    } else if (command & LCD_SET_CGRAM_ADDR) {
+        cursor_addr = LCD_CURSOR_UNKNOWN;
+    } else if (command == LCD_CLEAR_DISPLAY) {
+        memset(ddram_shadow, ' ', sizeof(ddram_shadow));
+        cursor_addr = 0x00;
+    } else if (command == LCD_RETURN_HOME) {
+        cursor_addr = 0x00;
+    }
 }
 
 void lcd_send_data(uint8_t data) {
     lcd_write_nibble(data >> 4, 1);   // Send high nibble, RS=1 (data)
     lcd_write_nibble(data & 0x0F, 1); // Send low nibble, RS=1 (data)
+
+    if (cursor_addr != LCD_CURSOR_UNKNOWN) {
+        uint8_t col = cursor_addr & 0x3F;
+        if (col < LCD_COLS) {
+            ddram_shadow[cursor_addr >> 6][col] = data;
+        }
+        cursor_addr++;
+        if (cursor_addr == 0x28) {          // End of line 0 wraps to line 1
+            cursor_addr = 0x40;
+        } else if (cursor_addr == 0x68) {   // End of line 1 wraps to line 0
+            cursor_addr = 0x00;
+        }
+    }
 }
 
 void lcd_print_char(char character) {
@@ -128,3 +229,156 @@ void blink_cursor(void) {
 void stop_blinking_cursor(void) {
     lcd_send_command(0x0C);
 }
+
+void lcd_put_char_at(uint8_t row, uint8_t col, uint8_t character) {
+    uint8_t ddram_addr;
+    if (row >= LCD_ROWS || col >= LCD_COLS) {
+        return;
+    }
+    if (ddram_shadow[row][col] == character) {
+        return; // Already on screen, nothing to send
+    }
+    ddram_addr = (row == 0 ? 0x00 : 0x40) + col;
+    if (cursor_addr != ddram_addr) {
+        position_lcd_cursor(row, col); // Consecutive cells skip the address command
+    }
+    lcd_send_data(character);
+}
+
+void print_message_at(uint8_t row, uint8_t col, const char* str) {
+    while (*str && col < LCD_COLS) {
+        lcd_put_char_at(row, col++, (uint8_t)*str++);
+    }
+}
+
+static void lcd_upload_glyph(uint8_t slot, uint8_t glyph) {
+    uint8_t row, col;
+    if (cgram_slot_glyph[slot] != GLYPH_NONE) {
+        // Cells still showing the evicted glyph would silently change shape
+        for (row = 0; row < LCD_ROWS; row++) {
+            for (col = 0; col < LCD_COLS; col++) {
+                if (ddram_shadow[row][col] == slot) {
+                    ddram_shadow[row][col] = LCD_SHADOW_STALE;
+                }
+            }
+        }
+    }
+    lcd_send_command(LCD_SET_CGRAM_ADDR | (slot << 3));
+    for (row = 0; row < LCD_GLYPH_HEIGHT; row++) {
+        lcd_send_data(glyph_patterns[glyph][row]);
+    }
+    cgram_slot_glyph[slot] = glyph;
+}
+
+// Returns the character code of a glyph, uploading it to CGRAM only if it isn't resident yet
+static uint8_t lcd_acquire_glyph(uint8_t glyph) {
+    uint8_t slot;
+    uint8_t victim = 0;
+    uint16_t victim_age = 0;
+
+    cgram_use_counter++;
+    for (slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+        if (cgram_slot_glyph[slot] == glyph) {
+            cgram_slot_last_use[slot] = cgram_use_counter;
+            return slot;
+        }
+    }
+    for (slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+        uint16_t age = cgram_use_counter - cgram_slot_last_use[slot];
+        if (cgram_slot_glyph[slot] == GLYPH_NONE) {
+            victim = slot; // Free slot, no need to evict anything
+            break;
+        }
+        if (age > victim_age) {
+            victim_age = age;
+            victim = slot;
+        }
+    }
+    lcd_upload_glyph(victim, glyph);
+    cgram_slot_last_use[victim] = cgram_use_counter;
+    return victim;
+}
+
+static uint8_t lcd_big_cell_code(char cell) {
+    switch (cell) {
+        case 'F': return LCD_FULL_BLOCK;
+        case 'T': return lcd_acquire_glyph(GLYPH_BIG_TOP);
+        case 'B': return lcd_acquire_glyph(GLYPH_BIG_BOTTOM);
+        case 'M': return lcd_acquire_glyph(GLYPH_BIG_BOTH);
+        default:  return ' ';
+    }
+}
+
+void lcd_print_big_digit(uint8_t col, uint8_t digit) {
+    uint8_t i;
+    if (digit > 9) {
+        return;
+    }
+    // Row by row, so changed cells next to each other share one address command
+    for (i = 0; i < LCD_BIG_DIGIT_WIDTH; i++) {
+        lcd_put_char_at(0, col + i, lcd_big_cell_code(big_digit_cells[digit][i]));
+    }
+    for (i = 0; i < LCD_BIG_DIGIT_WIDTH; i++) {
+        lcd_put_char_at(1, col + i, lcd_big_cell_code(big_digit_cells[digit][LCD_BIG_DIGIT_WIDTH + i]));
+    }
+}
+
+// filled_steps goes from 0 (empty) to LCD_BAR_STEPS (full), one step per pixel column
+void lcd_print_progress_bar(uint8_t row, uint8_t filled_steps) {
+    uint8_t col;
+    uint8_t code;
+    if (filled_steps > LCD_BAR_STEPS) {
+        filled_steps = LCD_BAR_STEPS;
+    }
+    for (col = 0; col < LCD_COLS; col++) {
+        if (filled_steps >= LCD_BAR_STEPS_PER_CELL) {
+            code = LCD_FULL_BLOCK;
+            filled_steps -= LCD_BAR_STEPS_PER_CELL;
+        } else if (filled_steps > 0) {
+            code = lcd_acquire_glyph(GLYPH_BAR_1 + filled_steps - 1);
+            filled_steps = 0;
+        } else {
+            code = ' ';
+        }
+        lcd_put_char_at(row, col, code);
+    }
+}
+
+void lcd_set_backlight_level(uint8_t level) {
+    unsigned short interrupt_state = __get_interrupt_state();
+
+    if (level > LCD_BACKLIGHT_FULL) {
+        level = LCD_BACKLIGHT_FULL;
+    }
+    __disable_interrupt();
+    backlight_level = level;
+    if (level == LCD_BACKLIGHT_OFF || level == LCD_BACKLIGHT_FULL) {
+        if (pwm_running) {
+            timebase_cancel_alarm(TIMEBASE_ALARM_BACKLIGHT);
+            pwm_running = 0;
+        }
+        backlight_state = level ? LCD_BL_BIT : 0; // Goes out with the next display write
+    } else if (!pwm_running) {
+        pwm_running = 1;
+        timebase_set_alarm(TIMEBASE_ALARM_BACKLIGHT, 1, backlight_pwm_edge);
+    }
+    __set_interrupt_state(interrupt_state);
+}
+
+uint8_t lcd_get_backlight_level(void) {
+    return backlight_level;
+}
+
+void lcd_flush_backlight(void) {
+    uint8_t pcf_byte;
+
+    if (pwm_running || wire_backlight == backlight_state) {
+        return; // PWM keeps the wire moving, or a display write already carried it
+    }
+    pcf_byte = backlight_state;
+    lcd_write_pcf8574(&pcf_byte, 1);
+}
+
+uint32_t lcd_get_i2c_write_count(void) {
+    return i2c_write_count;
+}
@@ -41,6 +41,21 @@
 #define LCD_DISPLAY_ON_CURSOR_ON_BLINK_OFF   0x0E
 #define LCD_DISPLAY_ON_CURSOR_OFF_BLINK_OFF  0x0C
 
+#define LCD_ROWS                    2
+#define LCD_COLS                    16
+#define LCD_CGRAM_SLOTS             8   // HD44780 holds 8 custom 5x8 glyphs
+#define LCD_GLYPH_HEIGHT            8
+
+#define LCD_BIG_DIGIT_WIDTH         3   // Big digits take 3 columns x 2 rows
+#define LCD_BIG_COLON               0xA5 // Centered dot in the A00 ROM, used as big clock separator
+#define LCD_FULL_BLOCK              0xFF // Solid 5x8 block in the A00 ROM
+#define LCD_BAR_STEPS_PER_CELL      5   // One step per pixel column of a 5x8 cell
+#define LCD_BAR_STEPS               (LCD_COLS * LCD_BAR_STEPS_PER_CELL)
+
+#define LCD_BACKLIGHT_OFF           0
+#define LCD_BACKLIGHT_FULL          16  // Levels in between are software PWM on LCD_BL_BIT
+#define LCD_BACKLIGHT_PWM_PERIOD    256 // timebase ticks (~128Hz)
+
 void configure_lcd(void);
 void lcd_send_command(uint8_t command);
 void lcd_send_data(uint8_t data);
@@ -51,4 +66,18 @@ void clear_lcd_screen(void);
 void blink_cursor(void);
 void stop_blinking_cursor(void);
 
+// Incremental writes: only cells whose content changed go out over I2C
+void lcd_put_char_at(uint8_t row, uint8_t col, uint8_t character);
+void print_message_at(uint8_t row, uint8_t col, const char* str);
+void lcd_print_big_digit(uint8_t col, uint8_t digit);
+void lcd_print_progress_bar(uint8_t row, uint8_t filled_steps);
+
+// Backlight: off/full changes ride on the next display write; lcd_flush_backlight()
+// pushes them out on their own only if no write carried them yet
+void lcd_set_backlight_level(uint8_t level);
+uint8_t lcd_get_backlight_level(void);
+void lcd_flush_backlight(void);
+
+uint32_t lcd_get_i2c_write_count(void);
+
 #endif
@@ -17,6 +17,12 @@
 #include <msp430.h>
 
 #include "lcd_display.h" 
+#include "uart_link.h"
+#include "i2c_bus.h"
+#include "timebase.h"
+#include "energy.h"
+#include "backlight.h"
+#include "deadline.h"
 
 #define PULSE_ZERO_TICKS 1700
 #define PULSE_ONE_TICKS  3000
@@ -34,6 +40,9 @@
 
 #define BUZZER_BEEP_DURATION 3
 
+#define COUNTER_VIEW_BIG_DIGITS 0
+#define COUNTER_VIEW_PROGRESS 1
+
 const char hexTable[] = "0123456789ABCDEF";
 volatile char irPulseBits[32];
 char irPulseBitsAddr[8];
@@ -58,16 +67,27 @@ char focus_minutes_unit = '1';
 char resting_minutes_tenth = '0';
 char resting_minutes_unit = '1';
 
-char* timer_minutes = "01";
-char* timer_seconds = "00";
+char timer_minutes[3] = "01";
+char timer_seconds[3] = "00";
 
 volatile int timer_minutes_int = 0;
 volatile int timer_seconds_int = 0;
 volatile int timer_active = 0;
 volatile int current_timer_type = FOCUS_TIME_SET_STEP;
+volatile int timer_total_seconds = 0;
+
+volatile int counter_view = COUNTER_VIEW_BIG_DIGITS;
+volatile int counterNeedsClear = 1;
+volatile int counterNeedsRefresh = 0; // Tick pendente de redesenho: só o main loop escreve no LCD
+volatile int resetRequested = 0;
 
 int isEditing = MINUTES_TENTH;
 
+// Contadores de profiling lidos pelo LINK_CMD_GET_COUNTERS
+volatile uint32_t tick_count = 0;
+volatile uint16_t ir_frame_count = 0;
+int reportedStep = -1;
+
 unsigned int i;
 
 void configure_receiver(void);
@@ -79,7 +99,7 @@ bool get_value(char* button);
 void handle_welcome_step();
 void handle_focus_time_set_step();
 void handle_rest_time_set_step();
-void byteToHex(const char input[8], char hex[2]);
+void byteToHex(const char input[8], char hex[3]);
 void show_focus_display();
 void show_rest_display();
 void show_counter_display();
@@ -88,30 +108,64 @@ void decrement_minutes();
 void decrement_timer(int step);
 void reset();
 void start_timer(int timer_type);
+void handle_link_frames();
+bool has_pending_work();
+bool inject_ir_command(uint8_t command);
+void send_session_event(uint8_t event);
+void send_tick_event();
+void send_counters();
+void send_energy(uint8_t which);
+void set_buzzer(bool on);
+bool send_bus_stats(uint8_t device);
+bool send_deadlines(uint8_t source);
+void send_fault();
 
 void main(void) {
     WDTCTL = WDTPW | WDTHOLD; // Stop watchdog timer
 
     configure_msp_button();
     configure_receiver();
+    configure_countdown_timer(); // Tick de 1 Hz desde o boot: acorda o main loop para alimentar o watchdog em qualquer tela
     configure_buzzer();
+    configure_uart_link();
+    configure_timebase();
+    configure_energy();
+    configure_i2c_bus();
 
     configure_lcd();
+    configure_backlight();
     clear_lcd_screen();
     position_lcd_cursor(0, 0);
     print_message("OK para escolher"); 
     position_lcd_cursor(1, 0);
     print_message("o tempo de foco");  
 
+    configure_deadline();   // Religa o watchdog: daqui em diante só o main loop o alimenta
     __enable_interrupt();   // Habilita interrupções
 
     while (1) {
+        if (resetRequested) {
+            resetRequested = 0;
+            __delay_cycles(20000);          // Debounce aqui, sem segurar as outras interrupções
+            if (!(P1IN & BIT1)) {           // Confirma o pressionamento
+                reset();
+            }
+        }
+
+        handle_link_frames();
+
+        if (currentStep != reportedStep) {
+            reportedStep = currentStep;
+            send_session_event(LINK_SESSION_STEP);
+        }
+
         if (currentStep <= RESTING_TIME_COUNTER_STEP) {
             if (signalReady) {
                 process_signal();
+                backlight_activity(); // Qualquer tecla acende o backlight
                 
                 if (currentStep == WELCOME_STEP) {
-                    if(timer_active) P2OUT |= BIT2;
+                    if(timer_active) set_buzzer(true);
                     handle_welcome_step();
                 } else if (currentStep == FOCUS_TIME_SET_STEP) {
                     handle_focus_time_set_step();
@@ -130,7 +184,7 @@ void main(void) {
                 
                 signalReady = 0;
                 irBitCount = 0;
-                TA1CCTL1 &= ~CCIFG; // Limpa flag de captura
+                TA1CCTL1 &= ~(CCIFG | COV); // Limpa flags de captura e de bordas perdidas com o receptor pausado
                 TA1CCTL1 |= CCIE;
             }
         } else {
@@ -140,23 +194,71 @@ void main(void) {
                     start_timer(FOCUS_TIME_SET_STEP);
                 }
                 
+                // Durante a contagem, * alterna entre relógio grande e barra de progresso
+                if (signalReady) {
+                    process_signal();
+                    backlight_activity();
+
+                    if (get_value("*")) {
+                        counter_view = (counter_view == COUNTER_VIEW_BIG_DIGITS) ? COUNTER_VIEW_PROGRESS : COUNTER_VIEW_BIG_DIGITS;
+                        counterNeedsClear = 1;
+                        show_counter_display();
+                    }
+
+                    signalReady = 0;
+                    irBitCount = 0;
+                    TA1CCTL1 &= ~(CCIFG | COV); // Limpa flags de captura e de bordas perdidas com o receptor pausado
+                    TA1CCTL1 |= CCIE;
+                }
+
+                // O TIMER0_A0_ISR só conta o tempo; o redesenho acontece aqui, com as interrupções ligadas
+                if (counterNeedsRefresh) {
+                    counterNeedsRefresh = 0;
+                    backlight_countdown_tick(); // Apagar o backlight por inatividade vai junto com o redesenho
+                    show_counter_display();
+                }
+
                 shouldBeep = 1;
                 // Se o tempo tiver chegado a 00:00 e estiver ativo, troca o timer atual
                 if (timer_minutes_int == 0 && timer_seconds_int == 0 && timer_active) {
                     timer_active = 0;
                     if (current_timer_type == FOCUS_TIME_SET_STEP) {
                         start_timer(RESTING_TIME_COUNTER_STEP);
-                        if (shouldBeep) P2OUT |= BIT2;
+                        if (shouldBeep) set_buzzer(true);
                     } else {
                         start_timer(FOCUS_TIME_SET_STEP);
-                       if (shouldBeep) P2OUT |= BIT2;
+                       if (shouldBeep) set_buzzer(true);
                     }
                 }
             }
         }
+
+        // Se nenhuma escrita no display levou a mudança do backlight, manda só ela
+        lcd_flush_backlight();
+
+        // Uma volta completa do main loop: alimenta o watchdog (o TIMER0_A0_ISR acorda o loop a cada 1s, com ou sem contagem)
+        deadline_kick();
+
+        // Dorme em LPM0 até alguma interrupção trazer trabalho (SMCLK segue ativo para I2C, UART e captura do IR)
+        __disable_interrupt();
+        if (!has_pending_work()) {
+            energy_sleep(LPM0_bits);
+        }
+        __enable_interrupt();
     }
 }
 
+bool has_pending_work() {
+    if (signalReady || resetRequested || uart_link_rx_pending() || currentStep != reportedStep) {
+        return true;
+    }
+    if (currentStep == TIMER_STEP) {
+        // Tick a redesenhar, timer ainda não iniciado ou chegou a 00:00 e precisa trocar de fase
+        return counterNeedsRefresh || !timer_active || (timer_minutes_int == 0 && timer_seconds_int == 0);
+    }
+    return false;
+}
+
 void handle_welcome_step(){ 
     if (get_value("OK")) {
         currentStep = FOCUS_TIME_SET_STEP;
@@ -239,7 +341,7 @@ void handle_focus_time_set_step() {
     
     timer_minutes[0] = focus_minutes_tenth;
     timer_minutes[1] = focus_minutes_unit;
-    timer_minutes[2] = '\n';
+    timer_minutes[2] = '\0';
 
     // Força atualização do lcd só se o input tiver sido processado por completo
     if (inputProcessed) {
@@ -275,31 +377,49 @@ void start_timer(int timer_type) {
     current_timer_type = timer_type;
     
     if (timer_type == FOCUS_TIME_SET_STEP) {
+        energy_cycle_start(); // Um ciclo de energia vai de um foco ao próximo
         timer_minutes_int = (focus_minutes_tenth - '0') * 10 + (focus_minutes_unit - '0');
     } else {
         timer_minutes_int = (resting_minutes_tenth - '0') * 10 + (resting_minutes_unit - '0');
     }
     
     timer_seconds_int = 0;
+    timer_total_seconds = timer_minutes_int * 60;
     timer_active = 1;
+    counterNeedsClear = 1;
     
     configure_countdown_timer();
+    backlight_activity(); // Troca de fase acende o backlight junto com o redesenho
     show_counter_display();
+    send_session_event(LINK_SESSION_PHASE);
 }
 
 void show_counter_display() {
-    stop_blinking_cursor();
-    clear_lcd_screen();
-    position_lcd_cursor(0, 0);
-    
+    // Limpa só na troca de fase/visualização; nos ticks o LCD recebe apenas as células que mudaram
+    if (counterNeedsClear) {
+        stop_blinking_cursor();
+        clear_lcd_screen();
+        counterNeedsClear = 0;
+    }
+
+    if (counter_view == COUNTER_VIEW_BIG_DIGITS) {
+        // MM:SS em dígitos de 3x2 células, inicial da fase no canto
+        lcd_print_big_digit(0, timer_minutes_int / 10);
+        lcd_print_big_digit(3, timer_minutes_int % 10);
+        lcd_put_char_at(0, 6, LCD_BIG_COLON);
+        lcd_put_char_at(1, 6, LCD_BIG_COLON);
+        lcd_print_big_digit(7, timer_seconds_int / 10);
+        lcd_print_big_digit(10, timer_seconds_int % 10);
+        lcd_put_char_at(0, 15, (current_timer_type == FOCUS_TIME_SET_STEP) ? 'F' : 'D');
+        return;
+    }
+
     if (current_timer_type == FOCUS_TIME_SET_STEP) {
-        print_message("FOCO!");
+        print_message_at(0, 0, "FOCO!");
     } else {
-        print_message("DESCANSO!");
+        print_message_at(0, 0, "DESCANSO!");
     }
-    
-    position_lcd_cursor(1, 0);
-    
+
     char time_display[6]; // "MM:SS\0"
     time_display[0] = (timer_minutes_int / 10) + '0';
     time_display[1] = (timer_minutes_int % 10) + '0';
@@ -307,8 +427,16 @@ void show_counter_display() {
     time_display[3] = (timer_seconds_int / 10) + '0';
     time_display[4] = (timer_seconds_int % 10) + '0';
     time_display[5] = '\0';
-    
-    print_message(time_display);
+
+    print_message_at(0, LCD_COLS - 5, time_display);
+
+    // Barra de 16 células com 5 passos cada, proporcional ao tempo decorrido
+    uint8_t filled_steps = LCD_BAR_STEPS;
+    if (timer_total_seconds > 0) {
+        uint16_t remaining = timer_minutes_int * 60 + timer_seconds_int;
+        filled_steps = (uint8_t)(((uint32_t)(timer_total_seconds - remaining) * LCD_BAR_STEPS) / timer_total_seconds);
+    }
+    lcd_print_progress_bar(1, filled_steps);
 }
 
 void handle_rest_time_set_step() {
@@ -465,6 +593,15 @@ void configure_buzzer(){
     P2OUT &= ~BIT2; // como pull-down
 }
 
+void set_buzzer(bool on) {
+    if (on) {
+        P2OUT |= BIT2;
+    } else {
+        P2OUT &= ~BIT2;
+    }
+    energy_set_load(ENERGY_BUZZER, on);
+}
+
 void process_signal() {
     // Quebra o sinal e atribui a cada variável o valor de sua responsabilidade
     for (i = 0; i < 8; ++i){
@@ -561,21 +698,248 @@ void reset() {
     resting_minutes_tenth = '0';
     resting_minutes_unit = '1';
 
-    timer_minutes = "01";
-    timer_seconds = "00";
+    strcpy(timer_minutes, "01");
+    strcpy(timer_seconds, "00");
 
     timer_minutes_int = 0;
     timer_seconds_int = 0;
     timer_active = 0;
     current_timer_type = FOCUS_TIME_SET_STEP;
+    timer_total_seconds = 0;
+    counterNeedsClear = 1;
+    counterNeedsRefresh = 0;
 
     isEditing = MINUTES_TENTH;
     
+    backlight_activity();
     clear_lcd_screen();
     position_lcd_cursor(0, 0);
     print_message("OK para escolher"); 
     position_lcd_cursor(1, 0);
     print_message("o tempo de foco"); 
+
+    send_session_event(LINK_SESSION_RESET);
+}
+
+static uint8_t* put_u16(uint8_t* out, uint16_t value) {
+    *out++ = (uint8_t)value;
+    *out++ = (uint8_t)(value >> 8);
+    return out;
+}
+
+static uint8_t* put_u32(uint8_t* out, uint32_t value) {
+    out = put_u16(out, (uint16_t)value);
+    return put_u16(out, (uint16_t)(value >> 16));
+}
+
+void send_session_event(uint8_t event) {
+    uint8_t payload[3];
+    payload[0] = event;
+    payload[1] = (uint8_t)currentStep;
+    payload[2] = (uint8_t)current_timer_type;
+    uart_link_send(LINK_MSG_SESSION, payload, sizeof(payload));
+}
+
+void send_tick_event() {
+    uint8_t payload[3];
+    payload[0] = (uint8_t)current_timer_type;
+    payload[1] = (uint8_t)timer_minutes_int;
+    payload[2] = (uint8_t)timer_seconds_int;
+    uart_link_send(LINK_MSG_TICK, payload, sizeof(payload));
+}
+
+void send_counters() {
+    uint8_t payload[20];
+    uint8_t* out = payload;
+    const volatile link_stats_t* stats = uart_link_stats();
+
+    __disable_interrupt(); // Os contadores de 32 bits são atualizados nas interrupções
+    out = put_u32(out, tick_count);
+    out = put_u16(out, ir_frame_count);
+    out = put_u32(out, lcd_get_i2c_write_count());
+    out = put_u16(out, stats->frames_rx);
+    out = put_u16(out, stats->frames_tx);
+    out = put_u16(out, stats->frame_errors);
+    out = put_u16(out, stats->rx_overflows);
+    out = put_u16(out, stats->tx_overflows);
+    __enable_interrupt();
+
+    uart_link_send(LINK_MSG_COUNTERS, payload, (uint8_t)(out - payload));
+}
+
+bool send_bus_stats(uint8_t device) {
+    uint8_t payload[22];
+    uint8_t* out = payload;
+    uint8_t address;
+    i2c_device_stats_t stats;
+    uint32_t busy, elapsed;
+
+    if (!i2c_bus_get_stats(device, &address, &stats)) {
+        return false;
+    }
+    *out++ = device;
+    *out++ = address;
+    i2c_bus_get_utilization(&busy, &elapsed); // Acumulados: o host faz a diferença entre duas leituras
+    out = put_u32(out, busy);
+    out = put_u32(out, elapsed);
+    out = put_u32(out, stats.transactions);
+    out = put_u16(out, stats.nacks);
+    out = put_u16(out, stats.failures);
+    out = put_u16(out, stats.transactions ? (uint16_t)(stats.latency_total / stats.transactions) : 0);
+    out = put_u16(out, stats.latency_max);
+
+    uart_link_send(LINK_MSG_BUS_STATS, payload, (uint8_t)(out - payload));
+    return true;
+}
+
+bool send_deadlines(uint8_t source) {
+    uint8_t payload[13];
+    uint8_t* out = payload;
+    uint16_t budget;
+    deadline_stats_t stats;
+
+    if (!deadline_get_stats(source, &budget, &stats)) {
+        return false;
+    }
+    *out++ = source;
+    out = put_u16(out, budget);
+    out = put_u32(out, stats.entries);
+    out = put_u16(out, stats.misses);
+    out = put_u16(out, stats.worst_latency_us);
+    out = put_u16(out, stats.worst_run_us);
+
+    uart_link_send(LINK_MSG_DEADLINES, payload, (uint8_t)(out - payload));
+    return true;
+}
+
+void send_fault() {
+    uint8_t payload[18];
+    uint8_t* out = payload;
+    deadline_fault_t fault;
+
+    deadline_get_fault(&fault);
+    *out++ = fault.source;
+    *out++ = fault.blocker;
+    out = put_u16(out, fault.latency_us);
+    out = put_u16(out, fault.budget_us);
+    out = put_u16(out, fault.blocker_run_us);
+    out = put_u32(out, fault.at);
+    out = put_u16(out, fault.boot);
+    out = put_u16(out, fault.boots);
+    out = put_u16(out, fault.watchdog_resets);
+
+    uart_link_send(LINK_MSG_FAULT, payload, (uint8_t)(out - payload));
+}
+
+void send_energy(uint8_t which) {
+    uint8_t payload[11 + 2 * ENERGY_CHANNELS];
+    uint8_t* out = payload;
+    energy_residency_t residency;
+    uint8_t channel;
+    uint16_t cycle = energy_cycle_count();
+
+    energy_get_cycle(which, &residency);
+    *out++ = which;
+    out = put_u16(out, which == ENERGY_CYCLE_LAST && cycle > 0 ? cycle - 1 : cycle);
+    out = put_u32(out, residency.duration);
+    out = put_u32(out, energy_charge_nah(&residency, energy_model()) / 1000);
+    for (channel = 0; channel < ENERGY_CHANNELS; channel++) {
+        uint32_t fraction = 0;
+        if (residency.duration) {
+            fraction = (uint32_t)(((uint64_t)residency.ticks[channel] << 16) / residency.duration);
+        }
+        out = put_u16(out, fraction > 0xFFFF ? 0xFFFF : (uint16_t)fraction);
+    }
+
+    uart_link_send(LINK_MSG_ENERGY, payload, (uint8_t)(out - payload));
+}
+
+// Monta um quadro NEC sintético (endereço 0x00) para o comando seguir o mesmo caminho de um sinal do controle
+bool inject_ir_command(uint8_t command) {
+    uint8_t frame_bytes[4];
+    uint8_t bit;
+    unsigned short interrupt_state = __get_interrupt_state();
+
+    // Sem interrupções entre o teste e a pausa: um quadro real completado aqui seria sobrescrito
+    __disable_interrupt();
+    if (signalReady) {
+        __set_interrupt_state(interrupt_state);
+        return false; // Ainda tem um comando pendente no main loop
+    }
+    TA1CCTL1 &= ~CCIE; // Pausa o receptor até o comando ser consumido
+    __set_interrupt_state(interrupt_state);
+
+    frame_bytes[0] = 0x00;
+    frame_bytes[1] = 0xFF;
+    frame_bytes[2] = command;
+    frame_bytes[3] = (uint8_t)~command;
+    for (bit = 0; bit < 32; ++bit) {
+        irPulseBits[bit] = (frame_bytes[bit / 8] & (0x80 >> (bit % 8))) ? 'U' : 'Z';
+    }
+    irBitCount = 32;
+    signalReady = 1;
+    return true;
+}
+
+void handle_link_frames() {
+    link_frame_t frame;
+    bool accepted;
+
+    while (uart_link_receive(&frame)) {
+        accepted = false;
+
+        if (frame.type == LINK_CMD_KEY && frame.length == 1) {
+            accepted = inject_ir_command(frame.payload[0]);
+        } else if (frame.type == LINK_CMD_SET_TIMES && frame.length == 2) {
+            uint8_t focus = frame.payload[0];
+            uint8_t rest = frame.payload[1];
+            if (focus >= 1 && focus <= 99 && rest >= 1 && rest <= 99) {
+                focus_minutes_tenth = (focus / 10) + '0';
+                focus_minutes_unit = (focus % 10) + '0';
+                resting_minutes_tenth = (rest / 10) + '0';
+                resting_minutes_unit = (rest % 10) + '0';
+                // Vale a partir da próxima fase; as telas de configuração já mostram o novo valor
+                if (currentStep == FOCUS_TIME_SET_STEP) {
+                    show_focus_display();
+                } else if (currentStep == RESTING_TIME_COUNTER_STEP) {
+                    show_rest_display();
+                }
+                accepted = true;
+            }
+        } else if (frame.type == LINK_CMD_GET_COUNTERS && frame.length == 0) {
+            send_counters(); // A própria resposta serve de confirmação
+            continue;
+        } else if (frame.type == LINK_CMD_GET_ENERGY && frame.length == 1 && frame.payload[0] <= ENERGY_CYCLE_CURRENT) {
+            send_energy(frame.payload[0]);
+            continue;
+        } else if (frame.type == LINK_CMD_SET_CURRENT && frame.length == 3) {
+            accepted = energy_set_current(frame.payload[0], frame.payload[1] | ((uint16_t)frame.payload[2] << 8));
+        } else if (frame.type == LINK_CMD_SET_BACKLIGHT && frame.length == 1) {
+            accepted = backlight_select_profile(frame.payload[0]);
+        } else if (frame.type == LINK_CMD_SET_BACKLIGHT && frame.length == 3) {
+            backlight_profile_t profile;
+            profile.active_level = frame.payload[0];
+            profile.idle_level = frame.payload[1];
+            profile.idle_timeout_s = frame.payload[2];
+            accepted = backlight_set_profile(&profile);
+        } else if (frame.type == LINK_CMD_GET_BUS_STATS && frame.length == 1) {
+            if (send_bus_stats(frame.payload[0])) {
+                continue;
+            }
+        } else if (frame.type == LINK_CMD_GET_DEADLINES && frame.length == 1) {
+            if (send_deadlines(frame.payload[0])) {
+                continue;
+            }
+        } else if (frame.type == LINK_CMD_GET_FAULT && (frame.length == 0 || (frame.length == 1 && frame.payload[0] == 1))) {
+            send_fault();
+            if (frame.length == 1) {
+                deadline_clear_fault(); // Só depois de enviado: o próximo atraso passa a ser capturado
+            }
+            continue;
+        }
+
+        uart_link_send(accepted ? LINK_MSG_ACK : LINK_MSG_NACK, &frame.type, 1);
+    }
 }
 
 static inline uint8_t pack_bits(const char bits[8]) {
@@ -600,20 +964,34 @@ void byteToHex(const char input[8], char hex[3]) {
 // Interrupção do botão
 #pragma vector=PORT1_VECTOR
 __interrupt void Port1_ISR(void) {
+    uint32_t now;
+
+    now = timebase_now();
+    energy_isr_enter(now);
+    deadline_isr_enter(DEADLINE_PORT1, now);
     if (P1IFG & BIT1) {                     // Verifica se a interrupção foi causada pelo botão S2
-        __delay_cycles(20000);      // Debounce
-        if (!(P1IN & BIT1)) {               // Confirma o pressionamento
-            reset();
-        }
+        resetRequested = 1;                 // O main loop faz o debounce e o reset: só ele escreve no LCD
     }
     P1IFG &= ~BIT1;                         // Limpa a flag de interrupção
+    now = timebase_now();
+    deadline_isr_exit(now);
+    energy_isr_exit(now);
+    __bic_SR_register_on_exit(LPM0_bits);   // Acorda o main loop
 }
 
 // Interrupção do timer do receptor IR
 #pragma vector=TIMER1_A1_VECTOR
 __interrupt void TIMER1_A1_ISR(void) {
+    uint32_t now;
+
+    now = timebase_now();
+    energy_isr_enter(now);
+    deadline_isr_enter(DEADLINE_TIMER1_A1, now);
     switch (__even_in_range(TA1IV, TA1IV_TAIFG)) {
         case TA1IV_TACCR1: // Captura de CCR1
+            // Atraso desde a borda capturada; com COV outra borda sobrescreveu uma que nem foi lida
+            deadline_check((TA1CCTL1 & COV) ? DEADLINE_LOST : DEADLINE_SMCLK_US(TA1R - TA1CCR1));
+            TA1CCTL1 &= ~COV;
             if (TA1CCR1 < PULSE_ZERO_TICKS) {
                 irPulseBits[irBitCount++] = 'Z';
             } else if (TA1CCR1 < PULSE_ONE_TICKS) {
@@ -633,17 +1011,28 @@ __interrupt void TIMER1_A1_ISR(void) {
     if (irBitCount >= 32) {
         TA1CCTL1 &= ~CCIE;  // Desabilita a interrupção de captura
         signalReady = 1;
+        ir_frame_count++;
+        __bic_SR_register_on_exit(LPM0_bits); // Acorda o main loop para processar o comando
     }
+    now = timebase_now();
+    deadline_isr_exit(now);
+    energy_isr_exit(now);
 }
 
 // Interrupção do timer do pomodoro (1Hz)
 #pragma vector=TIMER0_A0_VECTOR
 __interrupt void TIMER0_A0_ISR(void) {
+    uint32_t now;
+
+    now = timebase_now();
+    energy_isr_enter(now);
+    deadline_isr_enter(DEADLINE_TIMER0_A0, now);
+    deadline_check(DEADLINE_ACLK_US(TA0R)); // TA0R voltou a 0 no instante do tick
     if (timer_active) {
         // Decrementa o timer em 1s
         if (timer_seconds_int > 0) {
             // Liga o buzzer por 3s
-            if(timer_seconds_int == 60 - BUZZER_BEEP_DURATION) P2OUT &= ~BIT2;
+            if(timer_seconds_int == 60 - BUZZER_BEEP_DURATION) set_buzzer(false);
             timer_seconds_int--;
         } else if (timer_minutes_int > 0) {
             timer_minutes_int--;
@@ -653,7 +1042,12 @@ __interrupt void TIMER0_A0_ISR(void) {
             timer_active = 0;
         }
         
-        // Atualiza a contagem no display
-        show_counter_display();
+        counterNeedsRefresh = 1; // Redesenhado pelo main loop
+        tick_count++;
+        send_tick_event();
     }
+    now = timebase_now();
+    deadline_isr_exit(now);
+    energy_isr_exit(now);
+    __bic_SR_register_on_exit(LPM0_bits); // Main loop verifica o fim da fase e alimenta o watchdog
 }
\ No newline at end of file
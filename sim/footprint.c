@@ -0,0 +1,904 @@
+// Footprint report for the firmware, checked against footprint.budget.
+//
+// Flash comes from the TI linker map that CCS leaves in Debug/: per memory region, per
+// output section and per input section, which with the compiler's one-section-per-function
+// layout means per function. The map is only as new as the last CCS build, so it must hold
+// an object for every firmware unit in the call graph; if one is missing the map predates
+// the code and its numbers are listed as stale instead of checked.
+//
+// RAM comes from the host objects of the current sources (nm -S, passed in with -d) plus
+// the project's STACK_SIZE (-s). Every type is at least as wide on x86-64 as on the MSP430
+// (int, enums, pointers, alignment of 32-bit fields), so .bss and .data are upper bounds.
+//
+// The MSP430 stack can't be measured
+// here. It is estimated from the gcc -fcallgraph-info=su call graph of an unoptimized host
+// build (-g): the deepest main path plus the deepest ISR, since ISRs don't nest, plus the
+// MSP430 interrupt entry. At -O0 every local has a stack slot, as in the CCS Debug build,
+// and each x86-64 frame (8-byte return address and frame pointer, wider types) is at least
+// as big as its cl430 counterpart. What the host graph can't show are the cl430 runtime
+// helpers: x86-64 divides and multiplies 64-bit values inline, but on the MSP430 the
+// 64-bit math in energy_charge_nah() and send_energy(), and every integer division, are
+// calls into __mspabi_* routines. They are leaves, so each path (main and ISR) gets one
+// RUNTIME_HELPER allowance at its deepest point. With it the estimate is an upper bound
+// and must fit STACK_SIZE.
+// The simulator's painted stack (-p) is a host-only regression signal.
+//
+// Exits with 1 if anything is over budget.
+
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE        512
+#define MAX_NAME        64
+#define MAX_REGIONS     96
+#define MAX_SECTIONS    96
+#define MAX_SYMBOLS     512
+#define MAX_FUNCTIONS   512
+#define MAX_EDGES       4096
+#define MAX_BUDGETS     128
+#define MAX_INDIRECT    16
+#define TOP_SYMBOLS     12
+#define VECTORS_START   0xFF80UL    // Interrupt vector table, 2-byte sections
+#define VECTORS_END     0x10000UL
+#define ISR_ENTRY       24          // PC+SR, and R11-R15 saved with PUSHM.A by an ISR that calls out
+#define RUNTIME_HELPER  64          // Deepest __mspabi_* call (64-bit divide): CALLA return address 4,
+                                    // R4-R10 saved with PUSHM.A 28, 64-bit quotient, remainder and
+                                    // shift count 20, rounded up
+
+typedef struct {
+    char name[MAX_NAME];
+    unsigned long origin;
+    unsigned long length;
+    unsigned long used;
+} region_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    unsigned long origin;
+    unsigned long length;
+} section_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    char object[MAX_NAME];
+    char section[MAX_NAME];             // Output section it was placed in
+    unsigned long size;
+} symbol_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    long frame;                         // -1: not defined in the firmware (sim accessor, libc)
+    bool dynamic;                       // alloca or VLA: frame is only a lower bound
+    int first_edge;
+    int state;                          // 0 unvisited, 1 on the current path, 2 done
+    long worst;
+    int worst_callee;
+} function_t;
+
+typedef struct {
+    int from;
+    int to;
+    int next;
+} edge_t;
+
+typedef enum { BUDGET_REGION, BUDGET_SECTION, BUDGET_SYMBOL, BUDGET_STACK } budget_kind_t;
+
+typedef struct {
+    budget_kind_t kind;
+    char name[MAX_NAME];
+    unsigned long limit;
+    int line;
+} budget_t;
+
+static region_t regions[MAX_REGIONS];
+static int region_count = 0;
+static section_t sections[MAX_SECTIONS];
+static int section_count = 0;
+static symbol_t symbols[MAX_SYMBOLS];
+static int symbol_count = 0;
+static char map_banner[MAX_LINE] = "";
+static char map_linked[MAX_LINE] = "";
+static char missing_objects[MAX_LINE] = ""; // Firmware units the map has no object for
+static bool ram_from_objects = false;
+
+static function_t functions[MAX_FUNCTIONS];
+static int function_count = 0;
+static edge_t edges[MAX_EDGES];
+static int edge_count = 0;
+static bool recursion = false;
+
+static budget_t budgets[MAX_BUDGETS];
+static int budget_count = 0;
+static unsigned long default_symbol_limit = 0;
+static char indirect_targets[MAX_INDIRECT][MAX_NAME];
+static int indirect_count = 0;
+
+static int checks = 0;
+static int over = 0;
+static int stale = 0;
+
+static void copy_name(char* dst, const char* src, size_t length) {
+    if (length >= MAX_NAME) {
+        length = MAX_NAME - 1;
+    }
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+}
+
+static void trim(char* text) {
+    size_t n = strlen(text);
+    while (n > 0 && (text[n - 1] == ' ' || text[n - 1] == '\t' || text[n - 1] == '\n' || text[n - 1] == '\r')) {
+        text[--n] = '\0';
+    }
+}
+
+static FILE* open_or_die(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        exit(2);
+    }
+    return in;
+}
+
+// ---------------------------------------------------------------------------
+// TI linker map
+
+static bool is_ram_section(const char* name) {
+    return strcmp(name, ".bss") == 0 || strcmp(name, ".data") == 0 || strcmp(name, ".stack") == 0 ||
+           strcmp(name, ".sysmem") == 0 || strcmp(name, ".TI.noinit") == 0;
+}
+
+static void add_symbol(const char* rest, unsigned long size, const char* section) {
+    const char* open = strchr(rest, '(');
+    const char* close = open ? strchr(open, ')') : NULL;
+    const char* object = rest;
+    const char* object_end = open ? open : rest + strlen(rest);
+    const char* name;
+    const char* colon;
+    symbol_t* symbol;
+
+    if (!open || !close || symbol_count == MAX_SYMBOLS || (ram_from_objects && is_ram_section(section))) {
+        return;
+    }
+    symbol = &symbols[symbol_count++];
+
+    // "lib : member.obj (...)" and its continuation lines ": member.obj (...)"
+    colon = memchr(object, ':', (size_t)(object_end - object));
+    if (colon) {
+        object = colon + 1;
+    }
+    while (object < object_end && *object == ' ') {
+        object++;
+    }
+    while (object_end > object && object_end[-1] == ' ') {
+        object_end--;
+    }
+    copy_name(symbol->object, object, (size_t)(object_end - object));
+
+    // ".text:_isr:TIMER1_A1_ISR" -> "TIMER1_A1_ISR", ".common:i" -> "i", ".stack" stays
+    name = open + 1;
+    for (colon = name; colon < close; colon++) {
+        if (*colon == ':') {
+            name = colon + 1;
+        }
+    }
+    copy_name(symbol->name, name, (size_t)(close - name));
+    copy_name(symbol->section, section, strlen(section));
+    symbol->size = size;
+}
+
+static void parse_map(const char* path) {
+    FILE* in = open_or_die(path);
+    char line[MAX_LINE];
+    enum { PREAMBLE, MEMORY, ALLOCATION, DONE } part = PREAMBLE;
+    char pending[MAX_NAME] = "";        // Output section whose numbers are on the next line
+    char current[MAX_NAME] = "";
+
+    while (fgets(line, sizeof(line), in)) {
+        char name[MAX_NAME];
+        unsigned long origin, length, used, page;
+        int n;
+
+        trim(line);
+        if (strstr(line, "MSP430 Linker") && !map_banner[0]) {
+            const char* start = line;
+            while (*start == ' ') {
+                start++;
+            }
+            snprintf(map_banner, sizeof(map_banner), "%s", start);
+        } else if (strncmp(line, ">> Linked ", 10) == 0) {
+            snprintf(map_linked, sizeof(map_linked), "%s", line + 10);
+        } else if (strcmp(line, "MEMORY CONFIGURATION") == 0) {
+            part = MEMORY;
+        } else if (strcmp(line, "SECTION ALLOCATION MAP") == 0) {
+            part = ALLOCATION;
+        } else if (strcmp(line, "MODULE SUMMARY") == 0) {
+            part = DONE;
+        } else if (part == MEMORY) {
+            if (sscanf(line, " %63s %lx %lx %lx", name, &origin, &length, &used) == 4 && region_count < MAX_REGIONS) {
+                region_t* region = &regions[region_count++];
+                snprintf(region->name, sizeof(region->name), "%s", name);
+                region->origin = origin;
+                region->length = length;
+                region->used = used;
+            }
+        } else if (part == ALLOCATION && line[0] != '\0') {
+            if (line[0] == ' ') {
+                if (sscanf(line, " %lx %lx %n", &origin, &length, &n) == 2 && current[0] && !strstr(line, "--HOLE--")) {
+                    add_symbol(line + n, length, current);
+                }
+                continue;
+            }
+            if (line[0] == '*' && pending[0]) {
+                snprintf(name, sizeof(name), "%s", pending);
+                pending[0] = '\0';
+                n = 1;
+            } else if (sscanf(line, "%63s %n", name, &n) != 1) {
+                continue;
+            }
+            if (sscanf(line + n, "%lu %lx %lx", &page, &origin, &length) != 3) {
+                // Long names put the numbers on a "*" line below
+                if (line[0] != '*' && line[0] != '-' && strcmp(name, "output") != 0 && strcmp(name, "section") != 0) {
+                    snprintf(pending, sizeof(pending), "%s", name);
+                }
+                continue;
+            }
+            snprintf(current, sizeof(current), "%s", name);
+            if (section_count < MAX_SECTIONS && !(ram_from_objects && is_ram_section(name))) {
+                section_t* section = &sections[section_count++];
+                snprintf(section->name, sizeof(section->name), "%s", name);
+                section->origin = origin;
+                section->length = length;
+            }
+        }
+    }
+    fclose(in);
+
+    if (section_count == 0) {
+        fprintf(stderr, "%s: no SECTION ALLOCATION MAP, not a TI linker map?\n", path);
+        exit(2);
+    }
+}
+
+static bool map_has_object(const char* object) {
+    int i;
+    for (i = 0; i < symbol_count; i++) {
+        if (strcmp(symbols[i].object, object) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// nm -S output of the host objects: "build/x.o:" headers, then "address size type name"
+
+static section_t* add_section(const char* name) {
+    if (section_count == MAX_SECTIONS) {
+        fprintf(stderr, "footprint: more than %d sections\n", MAX_SECTIONS);
+        exit(2);
+    }
+    snprintf(sections[section_count].name, MAX_NAME, "%s", name);
+    sections[section_count].origin = 0;
+    sections[section_count].length = 0;
+    return &sections[section_count++];
+}
+
+static void parse_objects(const char* path, unsigned long stack_size) {
+    FILE* in = open_or_die(path);
+    char line[MAX_LINE];
+    char object[MAX_NAME] = "";
+    section_t* bss = add_section(".bss");
+    section_t* data = add_section(".data");
+    section_t* stack = add_section(".stack");
+    int i;
+
+    while (fgets(line, sizeof(line), in)) {
+        char name[MAX_NAME];
+        unsigned long address, size;
+        char type;
+        size_t n;
+
+        trim(line);
+        n = strlen(line);
+        if (n > 1 && line[n - 1] == ':') {
+            const char* base = strrchr(line, '/');
+            base = base ? base + 1 : line;
+            copy_name(object, base, strlen(base) - 1);
+        } else if (sscanf(line, "%lx %lx %c %63s", &address, &size, &type, name) == 4 &&
+                   strchr("bBdD", type) && symbol_count < MAX_SYMBOLS) {
+            symbol_t* symbol = &symbols[symbol_count++];
+            section_t* section = type == 'b' || type == 'B' ? bss : data;
+            snprintf(symbol->name, MAX_NAME, "%s", name);
+            snprintf(symbol->object, MAX_NAME, "%s", object);
+            snprintf(symbol->section, MAX_NAME, "%s", section->name);
+            symbol->size = size;
+            section->length += size;
+        }
+    }
+    fclose(in);
+    stack->length = stack_size;
+
+    // The map's RAM region keeps its origin and length; its use is recomputed from the objects
+    for (i = 0; i < region_count; i++) {
+        if (strcmp(regions[i].name, "RAM") == 0) {
+            regions[i].used = bss->length + data->length + stack->length;
+            return;
+        }
+    }
+    fprintf(stderr, "footprint: the map has no RAM region\n");
+    exit(2);
+}
+
+// A unit whose object isn't in the map was added after the last CCS build
+static void check_map_objects(const char* unit) {
+    char object[MAX_NAME + 4];
+    size_t n = strlen(missing_objects);
+
+    snprintf(object, sizeof(object), "%s.obj", unit);
+    if (!map_has_object(object)) {
+        snprintf(missing_objects + n, sizeof(missing_objects) - n, "%s%s", n ? " " : "", object);
+    }
+}
+
+static bool is_vector(unsigned long origin) {
+    return origin >= VECTORS_START && origin < VECTORS_END;
+}
+
+static const region_t* find_region(const char* name) {
+    int i;
+    for (i = 0; i < region_count; i++) {
+        if (strcmp(regions[i].name, name) == 0) {
+            return &regions[i];
+        }
+    }
+    return NULL;
+}
+
+static const section_t* find_section(const char* name) {
+    int i;
+    for (i = 0; i < section_count; i++) {
+        if (strcmp(sections[i].name, name) == 0) {
+            return &sections[i];
+        }
+    }
+    return NULL;
+}
+
+static const symbol_t* find_symbol(const char* name) {
+    int i;
+    for (i = 0; i < symbol_count; i++) {
+        if (strcmp(symbols[i].name, name) == 0) {
+            return &symbols[i];
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// gcc -fcallgraph-info=su output (.ci, VCG format), one file per translation unit
+
+static int function_index(const char* name) {
+    int i;
+    for (i = 0; i < function_count; i++) {
+        if (strcmp(functions[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (function_count == MAX_FUNCTIONS) {
+        fprintf(stderr, "footprint: more than %d functions in the call graph\n", MAX_FUNCTIONS);
+        exit(2);
+    }
+    snprintf(functions[function_count].name, MAX_NAME, "%s", name);
+    functions[function_count].frame = -1;
+    functions[function_count].first_edge = -1;
+    return function_count++;
+}
+
+// Copies the quoted value after key ("title: \"main\"") into out
+static bool vcg_field(const char* line, const char* key, char* out) {
+    const char* start = strstr(line, key);
+    const char* end;
+
+    if (!start) {
+        return false;
+    }
+    start += strlen(key);
+    end = strchr(start, '"');
+    if (!end) {
+        return false;
+    }
+    copy_name(out, start, (size_t)(end - start));
+    return true;
+}
+
+static void parse_callgraph_file(const char* path) {
+    FILE* in = open_or_die(path);
+    char line[MAX_LINE * 2];
+
+    while (fgets(line, sizeof(line), in)) {
+        char name[MAX_NAME];
+        char target[MAX_NAME];
+        const char* bytes;
+
+        if (strncmp(line, "node:", 5) == 0 && vcg_field(line, "title: \"", name)) {
+            function_t* function = &functions[function_index(name)];
+            bytes = strstr(line, " bytes (");
+            if (bytes) {                // Only nodes defined in this unit carry a frame size
+                const char* digits = bytes;
+                long frame;
+                while (digits > line && digits[-1] >= '0' && digits[-1] <= '9') {
+                    digits--;
+                }
+                frame = strtol(digits, NULL, 10);
+                if (frame > function->frame) {
+                    function->frame = frame; // Same-named statics in two units: keep the bigger
+                }
+                if (strncmp(bytes, " bytes (dynamic", 15) == 0) {
+                    function->dynamic = true;
+                }
+            }
+        } else if (strncmp(line, "edge:", 5) == 0 && vcg_field(line, "sourcename: \"", name) &&
+                   vcg_field(line, "targetname: \"", target)) {
+            edge_t* edge;
+            if (edge_count == MAX_EDGES) {
+                fprintf(stderr, "footprint: more than %d call edges\n", MAX_EDGES);
+                exit(2);
+            }
+            edge = &edges[edge_count];
+            edge->from = function_index(name);
+            edge->to = function_index(target);
+            edge->next = functions[edge->from].first_edge;
+            functions[edge->from].first_edge = edge_count++;
+        }
+    }
+    fclose(in);
+}
+
+static int parse_callgraph(const char* dir) {
+    DIR* listing = opendir(dir);
+    struct dirent* entry;
+    int files = 0;
+
+    if (!listing) {
+        perror(dir);
+        exit(2);
+    }
+    while ((entry = readdir(listing)) != NULL) {
+        size_t n = strlen(entry->d_name);
+        char path[MAX_LINE];
+        if (n > 3 && strcmp(entry->d_name + n - 3, ".ci") == 0 && strcmp(entry->d_name, "sim.ci") != 0) {
+            char unit[MAX_NAME];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            parse_callgraph_file(path);
+            copy_name(unit, entry->d_name, n - 3);
+            check_map_objects(unit);
+            files++;
+        }
+    }
+    closedir(listing);
+    return files;
+}
+
+static long worst_depth(int index);
+
+// gcc names static functions "../file.c:name"; an indirect target matches either form
+static bool same_function(const char* node, const char* name) {
+    const char* colon = strrchr(node, ':');
+    return strcmp(node, name) == 0 || (colon && strcmp(colon + 1, name) == 0);
+}
+
+// Function pointers show up as calls to __indirect_call: charge the deepest listed target
+static long worst_indirect(int* callee) {
+    long worst = 0;
+    int i, f;
+    for (i = 0; i < indirect_count; i++) {
+        for (f = 0; f < function_count; f++) {
+            long depth;
+            if (!same_function(functions[f].name, indirect_targets[i])) {
+                continue;
+            }
+            depth = worst_depth(f);
+            if (depth > worst) {
+                worst = depth;
+                *callee = f;
+            }
+        }
+    }
+    return worst;
+}
+
+static long worst_depth(int index) {
+    function_t* function = &functions[index];
+    int e;
+
+    if (function->state == 2) {
+        return function->worst;
+    }
+    if (function->state == 1) {
+        recursion = true;           // Unbounded; the cycle is counted once
+        return 0;
+    }
+    if (function->frame < 0 && strcmp(function->name, "__indirect_call") != 0) {
+        function->state = 2;        // Simulator accessor or libc: not firmware stack
+        function->worst = 0;
+        function->worst_callee = -1;
+        return 0;
+    }
+
+    function->state = 1;
+    function->worst = 0;
+    function->worst_callee = -1;
+    if (strcmp(function->name, "__indirect_call") == 0) {
+        function->worst = worst_indirect(&function->worst_callee);
+    } else {
+        for (e = function->first_edge; e >= 0; e = edges[e].next) {
+            long depth = worst_depth(edges[e].to);
+            if (depth > function->worst) {
+                function->worst = depth;
+                function->worst_callee = edges[e].to;
+            }
+        }
+        function->worst += function->frame;
+    }
+    function->state = 2;
+    return function->worst;
+}
+
+static void print_path(int index) {
+    printf("              ");
+    while (index >= 0) {
+        printf("%s%s", functions[index].name, functions[index].worst_callee >= 0 ? " > " : "\n");
+        index = functions[index].worst_callee;
+    }
+}
+
+static bool is_isr(const char* name) {
+    size_t n = strlen(name);
+    return n > 4 && strcmp(name + n - 4, "_ISR") == 0;
+}
+
+// Deepest main path plus the deepest ISR on top of it
+static long static_stack(bool verbose) {
+    int main_index = function_index("firmware_main");
+    int worst_isr = -1;
+    long main_depth = worst_depth(main_index);
+    long isr_depth = 0;
+    bool dynamic = false;
+    int i;
+
+    for (i = 0; i < function_count; i++) {
+        if (is_isr(functions[i].name) && functions[i].frame >= 0) {
+            long depth = worst_depth(i);
+            if (depth > isr_depth) {
+                isr_depth = depth;
+                worst_isr = i;
+            }
+        }
+        dynamic |= functions[i].dynamic;
+    }
+
+    main_depth += RUNTIME_HELPER;
+    isr_depth += RUNTIME_HELPER;
+    printf("stack         static %ld bytes (MSP430 estimate): main %ld + %s %ld + entry %d%s%s\n",
+           main_depth + isr_depth + ISR_ENTRY, main_depth, worst_isr >= 0 ? functions[worst_isr].name : "no ISR",
+           isr_depth, ISR_ENTRY, recursion ? ", recursion not bounded" : "",
+           dynamic ? ", dynamic frames not bounded" : "");
+    printf("              each path includes %d bytes for the __mspabi_* runtime helpers\n", RUNTIME_HELPER);
+    if (verbose) {
+        print_path(main_index);
+        if (worst_isr >= 0) {
+            print_path(worst_isr);
+        }
+    }
+    return main_depth + isr_depth + ISR_ENTRY;
+}
+
+// ---------------------------------------------------------------------------
+// Budgets
+
+static void budget_error(const char* path, int line, const char* message) {
+    fprintf(stderr, "%s:%d: %s\n", path, line, message);
+    exit(2);
+}
+
+static void load_budgets(const char* path) {
+    FILE* in = open_or_die(path);
+    char buffer[MAX_LINE];
+    int line = 0;
+
+    while (fgets(buffer, sizeof(buffer), in)) {
+        char* comment = strchr(buffer, '#');
+        char* kind;
+        char* name;
+        char* limit;
+        char* end;
+
+        line++;
+        if (comment) {
+            *comment = '\0';
+        }
+        kind = strtok(buffer, " \t\r\n");
+        if (!kind) {
+            continue;
+        }
+        name = strtok(NULL, " \t\r\n");
+        if (strcmp(kind, "indirect") == 0) {
+            for (; name; name = strtok(NULL, " \t\r\n")) {
+                if (indirect_count == MAX_INDIRECT) {
+                    budget_error(path, line, "too many indirect call targets");
+                }
+                snprintf(indirect_targets[indirect_count++], MAX_NAME, "%s", name);
+            }
+            continue;
+        }
+        limit = strtok(NULL, " \t\r\n");
+        if (strcmp(kind, "default-symbol") == 0) {
+            limit = name;
+        }
+        if (!name || !limit) {
+            budget_error(path, line, "expected: <region|section|symbol|stack> <name> <bytes>");
+        }
+        if (strcmp(kind, "default-symbol") == 0) {
+            default_symbol_limit = strtoul(limit, &end, 0);
+            if (*end) {
+                budget_error(path, line, "bad byte count");
+            }
+            continue;
+        }
+        if (budget_count == MAX_BUDGETS) {
+            budget_error(path, line, "too many budgets");
+        }
+        if (strcmp(kind, "region") == 0) {
+            budgets[budget_count].kind = BUDGET_REGION;
+        } else if (strcmp(kind, "section") == 0) {
+            budgets[budget_count].kind = BUDGET_SECTION;
+        } else if (strcmp(kind, "symbol") == 0) {
+            budgets[budget_count].kind = BUDGET_SYMBOL;
+        } else if (strcmp(kind, "stack") == 0 && (strcmp(name, "static") == 0 || strcmp(name, "painted") == 0)) {
+            budgets[budget_count].kind = BUDGET_STACK;
+        } else {
+            budget_error(path, line, "unknown budget kind");
+        }
+        snprintf(budgets[budget_count].name, MAX_NAME, "%s", name);
+        budgets[budget_count].limit = strtoul(limit, &end, 0);
+        budgets[budget_count].line = line;
+        if (*end) {
+            budget_error(path, line, "bad byte count");
+        }
+        budget_count++;
+    }
+    fclose(in);
+}
+
+static bool symbol_budgeted(const char* name) {
+    int i;
+    for (i = 0; i < budget_count; i++) {
+        if (budgets[i].kind == BUDGET_SYMBOL && strcmp(budgets[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Map numbers don't describe the current code once the map is stale
+static bool from_map(const budget_t* budget) {
+    const symbol_t* symbol;
+
+    if (budget->kind == BUDGET_REGION || budget->kind == BUDGET_SECTION) {
+        return !(ram_from_objects && (strcmp(budget->name, "RAM") == 0 || is_ram_section(budget->name)));
+    }
+    if (budget->kind == BUDGET_SYMBOL) {
+        symbol = find_symbol(budget->name);
+        return !symbol || strstr(symbol->object, ".obj") != NULL;
+    }
+    return false;
+}
+
+static void check(const char* kind, const char* name, unsigned long actual, unsigned long limit) {
+    bool ok = actual <= limit;
+
+    checks++;
+    if (!ok) {
+        over++;
+    }
+    printf("  %-8s %-32s %6lu / %-6lu %3lu%%  %s\n", kind, name, actual, limit,
+           limit ? actual * 100 / limit : 100, ok ? "ok" : "OVER BUDGET");
+}
+
+static void check_budgets(long static_depth, long painted_depth) {
+    static const char* const kinds[] = { "region", "section", "symbol", "stack" };
+    int i;
+
+    printf("budget\n");
+    for (i = 0; i < budget_count; i++) {
+        const budget_t* budget = &budgets[i];
+        const char* kind = kinds[budget->kind];
+        long actual = -1;
+
+        if (budget->kind == BUDGET_REGION) {
+            const region_t* region = find_region(budget->name);
+            actual = region ? (long)region->used : -1;
+        } else if (budget->kind == BUDGET_SECTION) {
+            const section_t* section = find_section(budget->name);
+            actual = section ? (long)section->length : -1;
+        } else if (budget->kind == BUDGET_SYMBOL) {
+            const symbol_t* symbol = find_symbol(budget->name);
+            actual = symbol ? (long)symbol->size : -1;
+        } else if (strcmp(budget->name, "static") == 0) {
+            actual = static_depth;
+        } else {
+            actual = painted_depth;
+        }
+
+        if (missing_objects[0] && from_map(budget)) {
+            printf("  %-8s %-32s %6s / %-6lu        stale map\n", kind, budget->name, "-", budget->limit);
+            stale++;
+            continue;
+        }
+        if (actual < 0) {
+            printf("  %-8s %-32s %6s / %-6lu        not measured\n", kind, budget->name, "-", budget->limit);
+            continue;
+        }
+        check(kind, budget->name, (unsigned long)actual, budget->limit);
+    }
+
+    // Everything without its own budget is held to the default, so new code can't hide
+    if (default_symbol_limit) {
+        for (i = 0; i < symbol_count; i++) {
+            bool map_symbol = strstr(symbols[i].object, ".obj") != NULL;
+            if (!symbol_budgeted(symbols[i].name) && symbols[i].size > default_symbol_limit &&
+                !(missing_objects[0] && map_symbol)) {
+                check("symbol", symbols[i].name, symbols[i].size, default_symbol_limit);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Report
+
+static int compare_symbols(const void* a, const void* b) {
+    const symbol_t* x = a;
+    const symbol_t* y = b;
+    return x->size < y->size ? 1 : x->size > y->size ? -1 : strcmp(x->name, y->name);
+}
+
+static void report_map(const char* path, int top) {
+    const char* separator = "";
+    int i;
+    int shown = 0;
+    unsigned long vectors = 0;
+
+    printf("map           %s", path);
+    if (map_banner[0] || map_linked[0]) {
+        printf(" (%s%s%s)", map_banner, map_banner[0] && map_linked[0] ? ", linked " : "", map_linked);
+    }
+    printf("\n");
+    if (missing_objects[0]) {
+        printf("              STALE: no %s; rebuild in CCS and commit the map\n", missing_objects);
+    }
+    if (ram_from_objects) {
+        printf("              RAM from the host objects (upper bound) and STACK_SIZE\n");
+    }
+
+    printf("regions      ");
+    for (i = 0; i < region_count; i++) {
+        if (regions[i].used && !is_vector(regions[i].origin)) {
+            printf("%s %s %lu/%lu bytes", separator, regions[i].name, regions[i].used, regions[i].length);
+            separator = ",";
+        }
+    }
+    printf("\n");
+
+    printf("sections     ");
+    separator = "";
+    for (i = 0; i < section_count; i++) {
+        if (is_vector(sections[i].origin)) {
+            vectors += sections[i].length;
+        } else {
+            printf("%s %s %lu", separator, sections[i].name, sections[i].length);
+            separator = ",";
+        }
+    }
+    printf("%s vectors %lu\n", separator, vectors);
+
+    qsort(symbols, (size_t)symbol_count, sizeof(symbols[0]), compare_symbols);
+    printf("largest\n");
+    for (i = 0; i < symbol_count && shown < top; i++) {
+        if (symbols[i].name[0] == '.' || symbols[i].name[0] == '_') {
+            continue;               // Whole-object sections and runtime support
+        }
+        printf("  %-40s %6lu  %-10s %s\n", symbols[i].name, symbols[i].size, symbols[i].section, symbols[i].object);
+        shown++;
+    }
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-m map] [-d nm-output -s bytes] [-g dir] [-p bytes] [-n count] [-v] budget-file\n"
+            "  -m  TI linker map (default ../Debug/projeto-final.map)\n"
+            "  -d  nm -S of the firmware objects: RAM comes from these instead of the map\n"
+            "  -s  STACK_SIZE of the CCS project, with -d\n"
+            "  -g  directory with the gcc -fcallgraph-info=su .ci files of an -O0 build (default build)\n"
+            "  -p  painted stack high-water mark reported by pomodoro-sim\n"
+            "  -n  how many of the largest symbols to list (default %d)\n"
+            "  -v  print the deepest call paths\n",
+            argv0, TOP_SYMBOLS);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    const char* map_path = "../Debug/projeto-final.map";
+    const char* callgraph_dir = "build";
+    const char* objects_path = NULL;
+    long stack_size = -1;
+    long painted = -1;
+    int top = TOP_SYMBOLS;
+    bool verbose = false;
+    long static_depth = -1;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (i + 1 >= argc) {
+            usage(argv[0]);
+        } else if (strcmp(argv[i], "-m") == 0) {
+            map_path = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0) {
+            objects_path = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0) {
+            stack_size = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-g") == 0) {
+            callgraph_dir = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0) {
+            painted = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            top = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (i != argc - 1 || (objects_path && stack_size < 0)) {
+        usage(argv[0]);
+    }
+
+    load_budgets(argv[i]);
+    ram_from_objects = objects_path != NULL;
+    parse_map(map_path);
+    if (objects_path) {
+        parse_objects(objects_path, (unsigned long)stack_size);
+    }
+
+    // Read before the report so it can say whether the map is stale
+    if (parse_callgraph(callgraph_dir) == 0) {
+        callgraph_dir = NULL;
+    }
+    report_map(map_path, top);
+    if (callgraph_dir) {
+        static_depth = static_stack(verbose);
+    } else {
+        printf("stack         no .ci files, build the simulator first\n");
+    }
+    if (painted >= 0) {
+        printf("              painted %ld bytes (pomodoro-sim, host frames)\n", painted);
+    }
+
+    check_budgets(static_depth, painted);
+    if (static_depth >= 0 && stack_size >= 0) {
+        check("stack", "static in STACK_SIZE", (unsigned long)static_depth, (unsigned long)stack_size);
+    }
+    printf("footprint     %d checks, %d over budget", checks, over);
+    if (stale) {
+        printf(", %d not checked until the map is rebuilt", stale);
+    }
+    printf("\n");
+    return over ? 1 : 0;
+}
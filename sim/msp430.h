@@ -0,0 +1,163 @@
+#ifndef SIM_MSP430_H
+#define SIM_MSP430_H
+
+// Host stand-in for the TI <msp430.h>: registers become plain variables owned by sim.c,
+// and the few registers whose reads or writes have side effects on real hardware go
+// through accessors so the simulator can model the peripheral behind them.
+
+#include <stdint.h>
+
+#ifdef SIM_DEFINE_REGISTERS
+#define SIM_REG8(name)  volatile uint8_t name
+#define SIM_REG16(name) volatile uint16_t name
+#else
+#define SIM_REG8(name)  extern volatile uint8_t name
+#define SIM_REG16(name) extern volatile uint16_t name
+#endif
+
+// Watchdog and reset cause
+SIM_REG16(WDTCTL);
+SIM_REG16(SYSRSTIV);
+
+// Ports
+SIM_REG8(P1DIR); SIM_REG8(P1REN); SIM_REG8(P1OUT); SIM_REG8(P1IN);
+SIM_REG8(P1IE);  SIM_REG8(P1IES); SIM_REG8(P1IFG); SIM_REG8(P1SEL);
+SIM_REG8(P2DIR); SIM_REG8(P2REN); SIM_REG8(P2OUT); SIM_REG8(P2IN);
+SIM_REG8(P2SEL);
+SIM_REG8(P3SEL);
+SIM_REG8(P4SEL);
+
+// USCI_B0 (I2C to the PCF8574)
+SIM_REG8(UCB0CTL0); SIM_REG8(UCB0BR0); SIM_REG8(UCB0BR1);
+SIM_REG8(UCB0IE);   SIM_REG8(UCB0RXBUF);
+SIM_REG16(UCB0I2CSA); SIM_REG16(UCB0IV);
+SIM_REG8(sim_reg_UCB0CTL1); SIM_REG8(sim_reg_UCB0IFG); SIM_REG8(sim_reg_UCB0TXBUF);
+
+// USCI_A1 (backchannel UART)
+SIM_REG8(UCA1CTL0); SIM_REG8(UCA1CTL1); SIM_REG8(UCA1BR0); SIM_REG8(UCA1BR1);
+SIM_REG8(UCA1MCTL); SIM_REG8(UCA1IE);   SIM_REG8(UCA1IFG); SIM_REG8(UCA1RXBUF);
+SIM_REG16(UCA1IV);
+SIM_REG8(sim_reg_UCA1TXBUF);
+
+// Timer0_A5 (1Hz countdown) and Timer1_A3 (IR capture)
+SIM_REG16(TA0CTL); SIM_REG16(TA0CCTL0); SIM_REG16(TA0CCR0); SIM_REG16(TA0IV); SIM_REG16(sim_reg_TA0R);
+SIM_REG16(TA1CTL); SIM_REG16(TA1CCTL1); SIM_REG16(TA1CCR1); SIM_REG16(TA1IV); SIM_REG16(sim_reg_TA1R);
+
+// Timer2_A3 (free-running time base)
+SIM_REG16(TA2CTL); SIM_REG16(TA2CCR1); SIM_REG16(TA2CCR2);
+SIM_REG16(sim_reg_TA2CCTL1); SIM_REG16(sim_reg_TA2CCTL2); SIM_REG16(sim_reg_TA2IV); SIM_REG16(sim_reg_TA2R);
+
+volatile uint8_t* sim_ucb0ctl1(void);
+volatile uint8_t* sim_ucb0ifg(void);
+volatile uint8_t* sim_ucb0txbuf(void);
+volatile uint8_t* sim_uca1txbuf(void);
+volatile uint16_t* sim_ta0r(void);
+volatile uint16_t* sim_ta1r(void);
+volatile uint16_t* sim_ta2cctl1(void);
+volatile uint16_t* sim_ta2cctl2(void);
+volatile uint16_t* sim_ta2iv(void);
+volatile uint16_t* sim_ta2r(void);
+
+#define UCB0CTL1    (*sim_ucb0ctl1())
+#define UCB0IFG     (*sim_ucb0ifg())
+#define UCB0TXBUF   (*sim_ucb0txbuf())
+#define UCA1TXBUF   (*sim_uca1txbuf())
+#define TA0R        (*sim_ta0r())
+#define TA1R        (*sim_ta1r())
+#define TA2CCTL1    (*sim_ta2cctl1())
+#define TA2CCTL2    (*sim_ta2cctl2())
+#define TA2IV       (*sim_ta2iv())
+#define TA2R        (*sim_ta2r())
+
+#define BIT0 0x0001
+#define BIT1 0x0002
+#define BIT2 0x0004
+#define BIT3 0x0008
+#define BIT4 0x0010
+#define BIT5 0x0020
+#define BIT6 0x0040
+#define BIT7 0x0080
+
+#define WDTPW       0x5A00
+#define WDTHOLD     0x0080
+#define WDTSSEL_0   0x0000
+#define WDTSSEL_1   0x0020
+#define WDTSSEL_2   0x0040
+#define WDTCNTCL    0x0008
+#define WDTIS_3     0x0003
+#define SYSRSTIV_NONE   0x0000
+#define SYSRSTIV_WDTTO  0x0016
+#define SYSRSTIV_WDTKEY 0x0018
+
+// Status register
+#define GIE         0x0008
+#define CPUOFF      0x0010
+#define OSCOFF      0x0020
+#define SCG0        0x0040
+#define SCG1        0x0080
+#define LPM0_bits   (CPUOFF)
+#define LPM1_bits   (SCG0 + CPUOFF)
+#define LPM2_bits   (SCG1 + CPUOFF)
+#define LPM3_bits   (SCG1 + SCG0 + CPUOFF)
+#define LPM4_bits   (SCG1 + SCG0 + OSCOFF + CPUOFF)
+
+// USCI
+#define UCSWRST     0x01
+#define UCSYNC      0x01
+#define UCMODE_3    0x06
+#define UCMST       0x08
+#define UCSSEL_2    0x80
+#define UCTXSTT     0x02
+#define UCTXSTP     0x04
+#define UCTXNACK    0x08
+#define UCTR        0x10
+#define UCRXIFG     0x01
+#define UCTXIFG     0x02
+#define UCNACKIFG   0x20
+#define UCRXIE      0x01
+#define UCTXIE      0x02
+#define UCNACKIE    0x20
+#define UCBRS_2     0x04
+#define UCBRF_0     0x00
+
+// Timer_A
+#define TAIFG       0x0001
+#define TAIE        0x0002
+#define TACLR       0x0004
+#define MC_1        0x0010
+#define MC_2        0x0020
+#define ID_0        0x0000
+#define TASSEL_1    0x0100
+#define TASSEL_2    0x0200
+#define CCIFG       0x0001
+#define COV         0x0002
+#define CCIE        0x0010
+#define CAP         0x0100
+#define SCS         0x0800
+#define CCIS_0      0x0000
+#define CM_2        0x8000
+#define TA1IV_TACCR1 0x0002
+#define TA1IV_TAIFG  0x000E
+#define TA2IV_TACCR1 0x0002
+#define TA2IV_TACCR2 0x0004
+#define TA2IV_TAIFG  0x000E
+
+// Intrinsics
+void sim_delay_cycles(unsigned long cycles);
+void sim_set_interrupt_state(unsigned short state);
+unsigned short sim_get_interrupt_state(void);
+void sim_bis_sr(unsigned short bits);
+void sim_bic_sr_on_exit(unsigned short bits);
+
+#define __delay_cycles(n)               sim_delay_cycles(n)
+#define __enable_interrupt()            sim_set_interrupt_state(GIE)
+#define __disable_interrupt()           sim_set_interrupt_state(0)
+#define __get_interrupt_state()         sim_get_interrupt_state()
+#define __set_interrupt_state(s)        sim_set_interrupt_state(s)
+#define __bis_SR_register(bits)         sim_bis_sr(bits)
+#define __bic_SR_register_on_exit(bits) sim_bic_sr_on_exit(bits)
+#define __even_in_range(value, range)   (value)
+#define __no_operation()                ((void)0)
+#define __interrupt
+
+#endif
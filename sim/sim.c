@@ -0,0 +1,1729 @@
+// Discrete-event host simulator for the Pomodoro firmware.
+//
+// The firmware sources are compiled unchanged against sim/msp430.h and run on a virtual
+// clock. Timer periods, IR edges, button presses, UART bytes and I2C completions are
+// events in a priority queue; whenever the firmware sleeps (LPM0) or calls
+// __delay_cycles(), the clock jumps straight to the next event instead of waiting, so a
+// 24h scenario runs in seconds. Register accesses that go through an accessor cost a
+// few cycles, which is what moves the clock forward while the firmware busy-waits, and
+// every interrupt and every wakeup costs a fixed number of cycles on top.
+// The firmware runs on its own painted stack, so the report can show how deep it got.
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#define SIM_DEFINE_REGISTERS
+#include "msp430.h"
+#include "energy.h"
+#include "timebase.h"
+#include "deadline.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define NS_PER_S        1000000000ULL
+#define NS_PER_MS       1000000ULL
+#define MCLK_HZ         1048576ULL  // DCO default after reset, also SMCLK
+#define ACCESS_CYCLES   4           // Cost of one peripheral register access
+// Firmware instructions are otherwise free, so the work every interrupt and every main-loop
+// pass repeats is charged as a flat cost. An ISR: acceptance and RETI (11), R11-R15 saved
+// and restored (24), two timebase_now() (~90), the energy and deadline hooks (~60) and the
+// vector switch. A pass: energy_sleep() on both sides (~110), the pending-work checks and
+// the watchdog kick (~60), the call into the handler. Bodies beyond their register
+// accesses still cost nothing, so active time stays a lower bound.
+#define ISR_CYCLES      200
+#define WAKE_CYCLES     200
+#define SMCLK_HZ        1048576ULL
+#define ACLK_HZ         32768ULL    // REFO
+
+#define LCD_I2C_ADDR    0x27        // PCF8574 backpack
+#define LCD_SETTLE_NS   (10 * NS_PER_MS) // Shorter-lived LCD states are redraw intermediates
+#define BUTTON_HOLD_NS  (200 * NS_PER_MS)
+#define UART_NOMINAL_BAUD 9600ULL
+#define PCF_BL_BIT      0x08
+#define BACKLIGHT_WINDOW_NS NS_PER_S // Duty cycle of "expect backlight <level>/16" is measured over this
+
+#define FIRMWARE_STACK_BYTES (256 * 1024)
+#define STACK_PAINT      0xA5
+
+#define MAX_EXPECTATIONS 1024
+#define MAX_LINE         256
+#define MAX_FRAME_PAYLOAD 32        // LINK_MAX_PAYLOAD
+
+// Firmware entry points
+void firmware_main(void);
+void TIMER0_A0_ISR(void);
+void TIMER1_A1_ISR(void);
+void Port1_ISR(void);
+void USCI_A1_ISR(void);
+void USCI_B0_ISR(void);
+void TIMER2_A1_ISR(void);
+
+// ---------------------------------------------------------------------------
+// Event queue
+
+typedef enum {
+    EV_TA0_PERIOD,
+    EV_TA2_OVERFLOW,
+    EV_TA2_COMPARE,
+    EV_IR_EDGE,
+    EV_BUTTON_PRESS,
+    EV_BUTTON_RELEASE,
+    EV_UART_RX,
+    EV_UART_TX_DONE,
+    EV_I2C_DONE,
+    EV_I2C_NACK,
+    EV_WDT_EXPIRE,
+    EV_EXPECT_MARK,     // Start of the window an "expect backlight <level>/16" measures
+    EV_EXPECT,
+    EV_END
+} event_type_t;
+
+typedef struct {
+    uint64_t time;
+    uint64_t seq;   // Keeps events scheduled for the same instant in FIFO order
+    event_type_t type;
+    uint32_t arg;
+} event_t;
+
+static event_t* heap = NULL;
+static size_t heap_count = 0;
+static size_t heap_capacity = 0;
+static uint64_t event_seq = 0;
+static uint64_t events_processed = 0;
+
+static bool event_before(const event_t* a, const event_t* b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void schedule(uint64_t time, event_type_t type, uint32_t arg) {
+    size_t i;
+    if (heap_count == heap_capacity) {
+        heap_capacity = heap_capacity ? heap_capacity * 2 : 256;
+        heap = realloc(heap, heap_capacity * sizeof(event_t));
+        if (!heap) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    i = heap_count++;
+    heap[i].time = time;
+    heap[i].seq = event_seq++;
+    heap[i].type = type;
+    heap[i].arg = arg;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        event_t tmp;
+        if (!event_before(&heap[i], &heap[parent])) {
+            break;
+        }
+        tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static event_t pop_event(void) {
+    event_t top = heap[0];
+    size_t i = 0;
+    heap[0] = heap[--heap_count];
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+        event_t tmp;
+        if (left < heap_count && event_before(&heap[left], &heap[smallest])) {
+            smallest = left;
+        }
+        if (right < heap_count && event_before(&heap[right], &heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+    return top;
+}
+
+// ---------------------------------------------------------------------------
+// CPU state
+
+static uint64_t now_ns = 0;
+static bool gie = false;
+static bool in_isr = false;
+static bool cpu_asleep = false;
+static bool wake_on_exit = false;
+static bool finishing = false;       // Reading firmware state for the report: the clock is frozen
+static unsigned short sleep_bits = 0;
+static uint64_t active_ns = 0;       // Ground truth for the energy report
+static uint64_t sleep_ns[5];         // Per LPM level
+
+enum { VEC_USCI_B0, VEC_TIMER0_A0, VEC_TIMER1_A1, VEC_PORT1, VEC_USCI_A1, VEC_TIMER2_A1, VEC_COUNT };
+static const char* const vector_names[VEC_COUNT] = {
+    "USCI_B0", "TIMER0_A0", "TIMER1_A1", "PORT1", "USCI_A1", "TIMER2_A1"
+};
+static uint64_t isr_count[VEC_COUNT];
+
+static void advance_to(uint64_t t);
+static void sample_energy_cycle(void);
+
+// ---------------------------------------------------------------------------
+// Output traces
+
+static FILE* lcd_trace = NULL;
+static FILE* buzzer_trace = NULL;
+static FILE* uart_trace = NULL;
+
+static void print_time(FILE* out, uint64_t t) {
+    fprintf(out, "%llu.%06llu", (unsigned long long)(t / NS_PER_S),
+            (unsigned long long)((t % NS_PER_S) / 1000));
+}
+
+// ---------------------------------------------------------------------------
+// HD44780 behind the PCF8574
+
+static uint8_t lcd_ddram[128];
+static uint8_t lcd_cgram[64];
+static uint8_t lcd_addr = 0;
+static bool lcd_cgram_mode = false;
+static bool lcd_8bit = true;
+static bool lcd_have_high = false;
+static uint8_t lcd_high_nibble = 0;
+static bool lcd_display_on = false;
+static bool lcd_dirty = true;
+static uint8_t pcf_port = 0xFF;      // Quasi-bidirectional outputs come up high: backlight on
+static uint64_t pcf_writes = 0;
+static uint64_t backlight_on_ns = 0;
+static uint64_t backlight_since_ns = 0;
+
+static char lcd_glyph_char(uint8_t slot) {
+    const uint8_t* rows = &lcd_cgram[(slot & 0x07) * 8];
+    uint8_t top = rows[0] | rows[1] | rows[2];
+    uint8_t bottom = rows[5] | rows[6] | rows[7];
+    int r;
+    bool uniform = true;
+    for (r = 1; r < 8; r++) {
+        if ((rows[r] & 0x1F) != (rows[0] & 0x1F)) {
+            uniform = false;
+        }
+    }
+    if (uniform && rows[0]) return '|';     // Progress bar partial cell
+    if (top && bottom) return '=';          // Big digit upper + middle stroke
+    if (top) return '^';                    // Big digit upper bar
+    if (bottom) return '_';                 // Big digit lower bar
+    return '*';
+}
+
+static void lcd_render_row(int row, char out[17]) {
+    int col;
+    for (col = 0; col < 16; col++) {
+        uint8_t c = lcd_ddram[(row ? 0x40 : 0x00) + col];
+        if (!lcd_display_on) {
+            c = ' ';
+        }
+        if (c < 0x10) {
+            out[col] = lcd_glyph_char(c);
+        } else if (c >= 0x20 && c < 0x7F) {
+            out[col] = (char)c;
+        } else if (c == 0xFF) {
+            out[col] = '#';
+        } else if (c == 0xA5) {
+            out[col] = ':';
+        } else {
+            out[col] = '?';
+        }
+    }
+    out[16] = '\0';
+}
+
+static void lcd_instruction(uint8_t c) {
+    if (c & 0x80) {
+        lcd_cgram_mode = false;
+        lcd_addr = c & 0x7F;
+    } else if (c & 0x40) {
+        lcd_cgram_mode = true;
+        lcd_addr = c & 0x3F;
+    } else if (c & 0x20) {
+        lcd_8bit = (c & 0x10) != 0;
+        lcd_have_high = false;
+    } else if (c & 0x10) {
+        // Cursor/display shift: not used by the firmware
+    } else if (c & 0x08) {
+        lcd_display_on = (c & 0x04) != 0;
+        lcd_dirty = true;
+    } else if (c & 0x04) {
+        // Entry mode: the firmware only uses increment without shift
+    } else if (c & 0x02) {
+        lcd_cgram_mode = false;
+        lcd_addr = 0;
+    } else if (c & 0x01) {
+        memset(lcd_ddram, ' ', sizeof(lcd_ddram));
+        lcd_cgram_mode = false;
+        lcd_addr = 0;
+        lcd_dirty = true;
+    }
+}
+
+static void lcd_data(uint8_t d) {
+    if (lcd_cgram_mode) {
+        lcd_cgram[lcd_addr & 0x3F] = d;
+        lcd_addr = (lcd_addr + 1) & 0x3F;
+    } else {
+        lcd_ddram[lcd_addr & 0x7F] = d;
+        lcd_addr++;
+        if (lcd_addr == 0x28) {
+            lcd_addr = 0x40;
+        } else if (lcd_addr == 0x68) {
+            lcd_addr = 0x00;
+        }
+    }
+    lcd_dirty = true;
+}
+
+static uint64_t backlight_on_total(void) {
+    return backlight_on_ns + ((pcf_port & PCF_BL_BIT) ? now_ns - backlight_since_ns : 0);
+}
+
+static void pcf8574_write(uint8_t value) {
+    uint8_t previous = pcf_port;
+    pcf_port = value;
+    pcf_writes++;
+    if ((previous ^ value) & PCF_BL_BIT) {
+        if (previous & PCF_BL_BIT) {
+            backlight_on_ns += now_ns - backlight_since_ns;
+        }
+        backlight_since_ns = now_ns;
+    }
+    // HD44780 latches on the falling edge of E (bit 2); D4..D7 on bits 4..7, RS on bit 0
+    if ((previous & 0x04) && !(value & 0x04)) {
+        uint8_t nibble = value >> 4;
+        bool rs = (value & 0x01) != 0;
+        if (lcd_8bit) {
+            if (!rs) {
+                lcd_instruction((uint8_t)(nibble << 4));
+            }
+        } else if (!lcd_have_high) {
+            lcd_high_nibble = nibble;
+            lcd_have_high = true;
+        } else {
+            uint8_t byte = (uint8_t)((lcd_high_nibble << 4) | nibble);
+            lcd_have_high = false;
+            if (rs) {
+                lcd_data(byte);
+            } else {
+                lcd_instruction(byte);
+            }
+        }
+    }
+}
+
+// LCD timeline: states that last less than LCD_SETTLE_NS are redraw intermediates and are dropped
+static char lcd_pending_text[2][17];
+static uint64_t lcd_pending_time = 0;
+static bool lcd_pending = false;
+static uint64_t lcd_states = 0;
+
+static void lcd_flush_pending(void) {
+    if (lcd_pending && lcd_trace) {
+        print_time(lcd_trace, lcd_pending_time);
+        fprintf(lcd_trace, " |%s|%s|\n", lcd_pending_text[0], lcd_pending_text[1]);
+    }
+    lcd_pending = false;
+}
+
+static void lcd_sample(void) {
+    char rows[2][17];
+    if (!lcd_dirty) {
+        return;
+    }
+    lcd_dirty = false;
+    lcd_render_row(0, rows[0]);
+    lcd_render_row(1, rows[1]);
+    if (lcd_pending && memcmp(rows, lcd_pending_text, sizeof(rows)) == 0) {
+        return;
+    }
+    if (lcd_pending && now_ns - lcd_pending_time >= LCD_SETTLE_NS) {
+        lcd_flush_pending();
+        lcd_states++;
+    }
+    memcpy(lcd_pending_text, rows, sizeof(rows));
+    lcd_pending_time = now_ns;
+    lcd_pending = true;
+}
+
+// ---------------------------------------------------------------------------
+// USCI_B0 I2C master: START, data bytes and STOP each take their bit times on the
+// wire and finish with an EV_I2C_DONE event, which raises the flag the firmware polls
+// or takes USCI_B0_ISR on
+
+enum { I2C_OP_ADDRESS, I2C_OP_DATA, I2C_OP_STOP };
+
+static bool i2c_busy = false;
+static bool i2c_txbuf_written = false;
+static uint64_t i2c_busy_ns = 0;
+static uint64_t i2c_transactions = 0;
+static uint64_t i2c_nacks = 0;
+static uint32_t i2c_forced_nacks = 0;   // Injected by the scenario: the LCD misses its address
+
+static uint64_t i2c_bit_ns(void) {
+    uint16_t divider = (uint16_t)(UCB0BR0 | (UCB0BR1 << 8));
+    if (divider == 0) {
+        divider = 1;
+    }
+    return divider * NS_PER_S / SMCLK_HZ;
+}
+
+static void i2c_start(uint32_t op, unsigned bits) {
+    uint64_t duration = bits * i2c_bit_ns();
+    if (op == I2C_OP_ADDRESS) {
+        sim_reg_UCB0IFG &= ~(UCTXIFG | UCNACKIFG);
+        i2c_transactions++;
+    } else if (op == I2C_OP_DATA) {
+        sim_reg_UCB0IFG &= ~UCTXIFG;
+    }
+    i2c_busy = true;
+    i2c_busy_ns += duration;
+    schedule(now_ns + duration, EV_I2C_DONE, op);
+}
+
+static void i2c_complete(uint32_t op) {
+    i2c_busy = false;
+    switch (op) {
+        case I2C_OP_ADDRESS:
+            sim_reg_UCB0CTL1 &= ~UCTXSTT;
+            if (UCB0I2CSA == LCD_I2C_ADDR && i2c_forced_nacks == 0) {
+                sim_reg_UCB0IFG |= UCTXIFG;
+            } else {
+                if (UCB0I2CSA == LCD_I2C_ADDR) {
+                    i2c_forced_nacks--;
+                }
+                sim_reg_UCB0IFG |= UCNACKIFG;
+                i2c_nacks++;
+            }
+            break;
+        case I2C_OP_DATA:
+            if (UCB0I2CSA == LCD_I2C_ADDR) {
+                pcf8574_write(sim_reg_UCB0TXBUF);
+            }
+            sim_reg_UCB0IFG |= UCTXIFG;
+            break;
+        case I2C_OP_STOP:
+            sim_reg_UCB0CTL1 &= ~UCTXSTP;
+            break;
+    }
+}
+
+// Starts whatever the firmware has asked for once the wire is free
+static void i2c_kick(void) {
+    if (i2c_busy || (sim_reg_UCB0CTL1 & UCSWRST)) {
+        return;
+    }
+    if (i2c_txbuf_written) {
+        i2c_txbuf_written = false;
+        i2c_start(I2C_OP_DATA, 9);
+    } else if (sim_reg_UCB0CTL1 & UCTXSTP) {
+        i2c_start(I2C_OP_STOP, 1);
+    } else if (sim_reg_UCB0CTL1 & UCTXSTT) {
+        i2c_start(I2C_OP_ADDRESS, 9);
+    }
+}
+
+static void register_access(void) {
+    i2c_kick();
+    advance_to(now_ns + ACCESS_CYCLES * NS_PER_S / MCLK_HZ);
+}
+
+volatile uint8_t* sim_ucb0ctl1(void) {
+    register_access();
+    return &sim_reg_UCB0CTL1;
+}
+
+volatile uint8_t* sim_ucb0ifg(void) {
+    register_access();
+    return &sim_reg_UCB0IFG;
+}
+
+volatile uint8_t* sim_ucb0txbuf(void) {
+    register_access();
+    i2c_txbuf_written = true; // The firmware only ever writes TXBUF
+    return &sim_reg_UCB0TXBUF;
+}
+
+// ---------------------------------------------------------------------------
+// USCI_A1 UART, optionally bridged to a pseudo-terminal
+
+static int pty_fd = -1;
+static int pty_slave_fd = -1;
+static bool uart_tx_busy = false;
+static uint64_t uart_rx_free_ns = 0;
+static uint64_t uart_tx_bytes = 0;
+static uint64_t uart_rx_bytes = 0;
+static uint64_t uart_rx_overruns = 0;
+
+typedef struct {
+    const char* direction;
+    uint8_t bytes[64];
+    uint8_t count;
+} frame_logger_t;
+
+// Last frame of each type the firmware sent, checked by "expect uart"
+typedef struct {
+    bool seen;
+    bool crc_ok;
+    uint64_t time;
+    uint8_t length;
+    uint8_t payload[64];
+} tx_frame_t;
+
+static frame_logger_t tx_logger = { "TX", { 0 }, 0 };
+static frame_logger_t rx_logger = { "RX", { 0 }, 0 };
+static tx_frame_t last_tx_frame[256];
+
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    size_t i;
+    int bit;
+    for (i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void log_uart_byte(frame_logger_t* logger, uint8_t byte) {
+    uint8_t i;
+    if (logger->count == 0 && byte != 0xA5) {
+        if (uart_trace) {
+            print_time(uart_trace, now_ns);
+            fprintf(uart_trace, " %s noise %02x\n", logger->direction, byte);
+        }
+        return;
+    }
+    logger->bytes[logger->count++] = byte;
+    // SYNC | LEN | TYPE | PAYLOAD[LEN] | CRC
+    if ((logger->count >= 2 && logger->count == logger->bytes[1] + 4) || logger->count == sizeof(logger->bytes)) {
+        if (logger == &tx_logger && logger->count >= 4) {
+            tx_frame_t* frame = &last_tx_frame[logger->bytes[2]];
+            frame->seen = true;
+            frame->time = now_ns;
+            frame->length = (uint8_t)(logger->count - 4);
+            frame->crc_ok = crc8(&logger->bytes[1], logger->count - 2) == logger->bytes[logger->count - 1];
+            memcpy(frame->payload, &logger->bytes[3], frame->length);
+        }
+        if (uart_trace) {
+            print_time(uart_trace, now_ns);
+            fprintf(uart_trace, " %s", logger->direction);
+            for (i = 0; i < logger->count; i++) {
+                fprintf(uart_trace, " %02x", logger->bytes[i]);
+            }
+            fputc('\n', uart_trace);
+        }
+        logger->count = 0;
+    }
+}
+
+static uint64_t uart_byte_ns(void) {
+    uint16_t divider = (uint16_t)(UCA1BR0 | (UCA1BR1 << 8));
+    if (divider == 0) {
+        return 10 * NS_PER_S / UART_NOMINAL_BAUD;
+    }
+    return 10ULL * divider * NS_PER_S / SMCLK_HZ; // Start + 8 data + stop
+}
+
+static void uart_schedule_rx(uint64_t t, uint8_t byte) {
+    uint64_t byte_ns = 10 * NS_PER_S / UART_NOMINAL_BAUD;
+    if (t < uart_rx_free_ns) {
+        t = uart_rx_free_ns;
+    }
+    uart_rx_free_ns = t + byte_ns;
+    schedule(uart_rx_free_ns, EV_UART_RX, byte);
+}
+
+volatile uint8_t* sim_uca1txbuf(void) {
+    UCA1IFG &= ~UCTXIFG;
+    if (!uart_tx_busy) {
+        uart_tx_busy = true;
+        schedule(now_ns + uart_byte_ns(), EV_UART_TX_DONE, 0); // Byte is latched when it leaves the shifter
+    }
+    return &sim_reg_UCA1TXBUF;
+}
+
+static void open_pty(void) {
+    struct termios tio;
+    const char* name;
+
+    pty_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty_fd < 0 || grantpt(pty_fd) < 0 || unlockpt(pty_fd) < 0 || !(name = ptsname(pty_fd))) {
+        perror("pty");
+        exit(2);
+    }
+    // Keep a slave handle open so the master doesn't read EIO before a client connects
+    pty_slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if (pty_slave_fd >= 0 && tcgetattr(pty_slave_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(pty_slave_fd, TCSANOW, &tio);
+    }
+    fcntl(pty_fd, F_SETFL, fcntl(pty_fd, F_GETFL) | O_NONBLOCK);
+    printf("pty: %s\n", name);
+    fflush(stdout);
+}
+
+// ---------------------------------------------------------------------------
+// Real-time pacing (only with -r or -p)
+
+static bool realtime = false;
+static struct timespec wall_start;
+
+static uint64_t wall_elapsed_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - wall_start.tv_sec) * NS_PER_S + (uint64_t)ts.tv_nsec - (uint64_t)wall_start.tv_nsec;
+}
+
+// Waits until wall time reaches virtual time t; returns true if pty input scheduled new events first
+static bool pace_until(uint64_t t) {
+    for (;;) {
+        uint64_t wall = wall_elapsed_ns();
+        struct pollfd pfd;
+        int timeout_ms;
+        if (wall >= t) {
+            return false;
+        }
+        timeout_ms = (t - wall) / NS_PER_MS > 100 ? 100 : (int)((t - wall) / NS_PER_MS) + 1;
+        if (pty_fd < 0) {
+            struct timespec ts = { 0, (long)((t - wall) % NS_PER_S) };
+            ts.tv_sec = (time_t)((t - wall) / NS_PER_S);
+            nanosleep(&ts, NULL);
+            continue;
+        }
+        pfd.fd = pty_fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+            uint8_t buffer[64];
+            ssize_t n = read(pty_fd, buffer, sizeof(buffer));
+            ssize_t i;
+            if (n > 0) {
+                uint64_t arrival = wall_elapsed_ns();
+                if (arrival < now_ns) {
+                    arrival = now_ns;
+                }
+                for (i = 0; i < n; i++) {
+                    uart_schedule_rx(arrival, buffer[i]);
+                }
+                return true;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Timers, buzzer and interrupt dispatch
+
+static uint32_t ta0_generation = 0;
+static uint16_t ta0_last_ctl = 0;
+static uint64_t ta0_period_start_ns = 0;
+static uint64_t ta1_epoch_ns = 0;
+static uint64_t ta2_epoch_ns = 0;
+static uint16_t ta2_last_ctl = 0;
+static uint16_t ta2_last_ccr[2];     // CCR1, CCR2
+static uint32_t ta2_generation = 0;
+static uint32_t ta2_compare_generation[2];
+static bool buzzer_on = false;
+static uint64_t buzzer_on_ns = 0;
+static uint64_t buzzer_since_ns = 0;
+static uint64_t ir_edges = 0;
+static uint16_t wdt_last_ctl = 0;
+static uint32_t wdt_generation = 0;
+static const char* watchdog_reset = NULL; // Why the watchdog would have reset the MCU
+
+static uint64_t ta0_period_ns(void) {
+    uint64_t clock = (TA0CTL & TASSEL_2) ? SMCLK_HZ : ACLK_HZ;
+    return ((uint64_t)TA0CCR0 + 1) * NS_PER_S / clock;
+}
+
+static uint16_t ta1_count_at(uint64_t t) {
+    if (t < ta1_epoch_ns) {
+        return 0;
+    }
+    return (uint16_t)((t - ta1_epoch_ns) * SMCLK_HZ / NS_PER_S);
+}
+
+// Up mode: counts from 0 at the start of each period
+volatile uint16_t* sim_ta0r(void) {
+    advance_to(now_ns + ACCESS_CYCLES * NS_PER_S / MCLK_HZ);
+    if (TA0CTL & (MC_1 | MC_2)) {
+        uint64_t clock = (TA0CTL & TASSEL_2) ? SMCLK_HZ : ACLK_HZ;
+        sim_reg_TA0R = (uint16_t)((now_ns - ta0_period_start_ns) * clock / NS_PER_S);
+    }
+    return &sim_reg_TA0R;
+}
+
+volatile uint16_t* sim_ta1r(void) {
+    advance_to(now_ns + ACCESS_CYCLES * NS_PER_S / MCLK_HZ);
+    if (TA1CTL & (MC_1 | MC_2)) {
+        sim_reg_TA1R = ta1_count_at(now_ns);
+    }
+    return &sim_reg_TA1R;
+}
+
+// Timer2_A: ACLK in continuous mode (the firmware time base)
+static bool ta2_running(void) {
+    return (TA2CTL & (MC_1 | MC_2)) != 0;
+}
+
+static uint64_t ta2_ticks_at(uint64_t t) {
+    return (t - ta2_epoch_ns) * ACLK_HZ / NS_PER_S;
+}
+
+static uint64_t ta2_time_of(uint64_t ticks) {
+    return ta2_epoch_ns + (ticks * NS_PER_S + ACLK_HZ - 1) / ACLK_HZ;
+}
+
+static volatile uint16_t* ta2_cctl(int n) {
+    return n == 0 ? &sim_reg_TA2CCTL1 : &sim_reg_TA2CCTL2;
+}
+
+static uint16_t ta2_ccr(int n) {
+    return n == 0 ? TA2CCR1 : TA2CCR2;
+}
+
+// Event argument: comparator in bit 0, its generation above
+static void ta2_schedule_compare(int n) {
+    uint64_t ticks = ta2_ticks_at(now_ns);
+    uint64_t ahead = (uint16_t)(ta2_ccr(n) - (uint16_t)ticks);
+    if (ahead == 0) {
+        ahead = 0x10000;
+    }
+    schedule(ta2_time_of(ticks + ahead), EV_TA2_COMPARE, (ta2_compare_generation[n] << 1) | (uint32_t)n);
+}
+
+volatile uint16_t* sim_ta2cctl1(void) {
+    advance_to(now_ns + ACCESS_CYCLES * NS_PER_S / MCLK_HZ);
+    return &sim_reg_TA2CCTL1;
+}
+
+volatile uint16_t* sim_ta2cctl2(void) {
+    advance_to(now_ns + ACCESS_CYCLES * NS_PER_S / MCLK_HZ);
+    return &sim_reg_TA2CCTL2;
+}
+
+// Reading TA2IV reports the highest-priority pending source and clears its flag
+volatile uint16_t* sim_ta2iv(void) {
+    sim_reg_TA2IV = 0;
+    if ((sim_reg_TA2CCTL1 & CCIE) && (sim_reg_TA2CCTL1 & CCIFG)) {
+        sim_reg_TA2IV = TA2IV_TACCR1;
+        sim_reg_TA2CCTL1 &= ~CCIFG;
+    } else if ((sim_reg_TA2CCTL2 & CCIE) && (sim_reg_TA2CCTL2 & CCIFG)) {
+        sim_reg_TA2IV = TA2IV_TACCR2;
+        sim_reg_TA2CCTL2 &= ~CCIFG;
+    } else if ((TA2CTL & TAIE) && (TA2CTL & TAIFG)) {
+        sim_reg_TA2IV = TA2IV_TAIFG;
+        TA2CTL &= ~TAIFG;
+    }
+    return &sim_reg_TA2IV;
+}
+
+volatile uint16_t* sim_ta2r(void) {
+    advance_to(now_ns + ACCESS_CYCLES * NS_PER_S / MCLK_HZ);
+    if (ta2_running()) {
+        sim_reg_TA2R = (uint16_t)ta2_ticks_at(now_ns);
+    }
+    return &sim_reg_TA2R;
+}
+
+static uint64_t wdt_period_ns(void) {
+    static const uint32_t dividers[8] = { 0x80000000UL, 0x8000000UL, 0x800000UL, 0x80000UL, 0x8000UL, 0x2000UL, 0x200UL, 0x40UL };
+    uint64_t clock = (WDTCTL & WDTSSEL_1) ? ACLK_HZ : (WDTCTL & WDTSSEL_2) ? 10000 : SMCLK_HZ; // VLO ~10kHz
+    return (uint64_t)dividers[WDTCTL & 0x7] * NS_PER_S / clock;
+}
+
+// Any write restarts the count: a kick (WDTCNTCL) or a new configuration
+static void sample_watchdog(void) {
+    if (WDTCTL == wdt_last_ctl && !(WDTCTL & WDTCNTCL)) {
+        return;
+    }
+    if ((WDTCTL & 0xFF00) != WDTPW) {
+        watchdog_reset = "password violation";
+        wdt_last_ctl = WDTCTL;
+        schedule(now_ns, EV_WDT_EXPIRE, ++wdt_generation);
+        return;
+    }
+    WDTCTL &= ~WDTCNTCL;
+    wdt_last_ctl = WDTCTL;
+    wdt_generation++;
+    if (!(WDTCTL & WDTHOLD)) {
+        schedule(now_ns + wdt_period_ns(), EV_WDT_EXPIRE, wdt_generation);
+    }
+}
+
+// Called whenever the firmware may have touched a register: picks up writes that
+// have side effects (TACLR, mode changes, buzzer pin) at the current virtual time
+static void sample(void) {
+    bool buzzer;
+    int n;
+
+    sample_watchdog();
+    sample_energy_cycle();
+
+    if ((TA0CTL & TACLR) || (TA0CTL & (MC_1 | MC_2)) != (ta0_last_ctl & (MC_1 | MC_2))) {
+        TA0CTL &= ~TACLR;
+        ta0_generation++;
+        ta0_period_start_ns = now_ns;
+        if (TA0CTL & (MC_1 | MC_2)) {
+            schedule(now_ns + ta0_period_ns(), EV_TA0_PERIOD, ta0_generation);
+        }
+    }
+    ta0_last_ctl = TA0CTL;
+
+    if (TA1CTL & TACLR) {
+        TA1CTL &= ~TACLR;
+        ta1_epoch_ns = now_ns;
+    }
+
+    if ((TA2CTL & TACLR) || (TA2CTL & (MC_1 | MC_2)) != (ta2_last_ctl & (MC_1 | MC_2))) {
+        if (TA2CTL & TACLR) {
+            TA2CTL &= ~TACLR;
+            ta2_epoch_ns = now_ns;
+        }
+        ta2_generation++;
+        if (ta2_running()) {
+            schedule(ta2_time_of((ta2_ticks_at(now_ns) | 0xFFFF) + 1), EV_TA2_OVERFLOW, ta2_generation);
+        }
+        ta2_last_ccr[0] = TA2CCR1 + 1; // Re-arm the comparators below
+        ta2_last_ccr[1] = TA2CCR2 + 1;
+    }
+    ta2_last_ctl = TA2CTL;
+    for (n = 0; n < 2; n++) {
+        if (ta2_ccr(n) != ta2_last_ccr[n]) {
+            ta2_last_ccr[n] = ta2_ccr(n);
+            ta2_compare_generation[n]++;
+            if (ta2_running()) {
+                ta2_schedule_compare(n);
+            }
+        }
+    }
+
+    i2c_kick();
+
+    buzzer = (P2DIR & BIT2) && (P2OUT & BIT2);
+    if (buzzer != buzzer_on) {
+        if (buzzer_on) {
+            buzzer_on_ns += now_ns - buzzer_since_ns;
+        }
+        buzzer_on = buzzer;
+        buzzer_since_ns = now_ns;
+        if (buzzer_trace) {
+            print_time(buzzer_trace, now_ns);
+            fprintf(buzzer_trace, " %s\n", buzzer ? "on" : "off");
+        }
+    }
+
+    lcd_sample();
+}
+
+static void run_isr(void (*isr)(void), int vector) {
+    gie = false;            // Cleared by the interrupt acceptance sequence
+    in_isr = true;
+    wake_on_exit = false;
+    isr_count[vector]++;
+    advance_to(now_ns + ISR_CYCLES * NS_PER_S / MCLK_HZ);
+    isr();
+    in_isr = false;
+    gie = true;             // RETI restores the stacked SR, which had GIE set
+    if (wake_on_exit) {
+        cpu_asleep = false;
+    }
+    sample();
+}
+
+// Services pending interrupts in MSP430F5529 priority order while GIE is set
+static void dispatch_pending(void) {
+    while (gie && !in_isr && !finishing) {
+        if ((UCB0IE & UCNACKIE) && (sim_reg_UCB0IFG & UCNACKIFG)) {
+            UCB0IV = 4;
+            sim_reg_UCB0IFG &= ~UCNACKIFG; // Reading UCB0IV clears the flag it reports
+            run_isr(USCI_B0_ISR, VEC_USCI_B0);
+        } else if ((UCB0IE & UCTXIE) && (sim_reg_UCB0IFG & UCTXIFG)) {
+            UCB0IV = 12;
+            sim_reg_UCB0IFG &= ~UCTXIFG;
+            run_isr(USCI_B0_ISR, VEC_USCI_B0);
+        } else if ((TA0CCTL0 & CCIE) && (TA0CCTL0 & CCIFG)) {
+            TA0CCTL0 &= ~CCIFG; // Single-source vector, flag clears on acceptance
+            run_isr(TIMER0_A0_ISR, VEC_TIMER0_A0);
+        } else if ((TA1CCTL1 & CCIE) && (TA1CCTL1 & CCIFG)) {
+            TA1IV = TA1IV_TACCR1;
+            TA1CCTL1 &= ~CCIFG; // Reading TA1IV clears the flag it reports
+            run_isr(TIMER1_A1_ISR, VEC_TIMER1_A1);
+        } else if (P1IE & P1IFG) {
+            run_isr(Port1_ISR, VEC_PORT1);
+        } else if ((UCA1IE & UCRXIE) && (UCA1IFG & UCRXIFG)) {
+            UCA1IV = 2;
+            UCA1IFG &= ~UCRXIFG;
+            run_isr(USCI_A1_ISR, VEC_USCI_A1);
+        } else if ((UCA1IE & UCTXIE) && (UCA1IFG & UCTXIFG)) {
+            UCA1IV = 4;
+            UCA1IFG &= ~UCTXIFG; // Reading UCA1IV clears TXIFG too: an idle link needs it raised again
+            run_isr(USCI_A1_ISR, VEC_USCI_A1);
+        } else if (((sim_reg_TA2CCTL1 & CCIE) && (sim_reg_TA2CCTL1 & CCIFG)) ||
+                   ((sim_reg_TA2CCTL2 & CCIE) && (sim_reg_TA2CCTL2 & CCIFG)) ||
+                   ((TA2CTL & TAIE) && (TA2CTL & TAIFG))) {
+            run_isr(TIMER2_A1_ISR, VEC_TIMER2_A1); // Flags stay up until the ISR reads TA2IV
+        } else {
+            break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scenario: scripted input and expectations
+
+typedef enum { EXPECT_LCD, EXPECT_BUZZER, EXPECT_BACKLIGHT, EXPECT_UART } expect_kind_t;
+
+typedef struct {
+    expect_kind_t kind;
+    int line;
+    int row;
+    bool on;
+    int level;                      // EXPECT_BACKLIGHT: n/16 duty over the last window, -1 for on/off now
+    uint64_t mark_on_ns;            // backlight_on_total() when that window started
+    char text[17];
+    uint8_t type;                   // EXPECT_UART: frame type and payload pattern
+    uint8_t length;
+    bool rest;                      // "..." at the end: trailing bytes aren't checked
+    uint8_t bytes[MAX_FRAME_PAYLOAD];
+    bool any[MAX_FRAME_PAYLOAD];    // ".." matches any byte
+    uint64_t since;                 // The frame must come after the last input line
+} expectation_t;
+
+static expectation_t expectations[MAX_EXPECTATIONS];
+static int expectation_count = 0;
+static int expectations_failed = 0;
+static uint64_t end_ns = UINT64_MAX;
+static const char* scenario_name = NULL;
+static struct timespec run_start;
+
+typedef struct {
+    const char* name;
+    uint8_t command; // Packed the way byteToHex() reads the bits, see get_value()
+} ir_key_t;
+
+static const ir_key_t keys[] = {
+    { "1", 0xA2 }, { "2", 0x62 }, { "3", 0xE2 }, { "4", 0x22 }, { "5", 0x02 },
+    { "6", 0xC2 }, { "7", 0xE0 }, { "8", 0xA8 }, { "9", 0x90 }, { "0", 0x98 },
+    { "*", 0x68 }, { "#", 0xB0 }, { "^", 0x18 }, { "V", 0x4A }, { "<", 0x10 },
+    { ">", 0x5A }, { "OK", 0x38 },
+};
+
+static void trim_right(char* text) {
+    size_t n = strlen(text);
+    while (n > 0 && text[n - 1] == ' ') {
+        text[--n] = '\0';
+    }
+}
+
+static void check_expectation(uint32_t index) {
+    const expectation_t* e = &expectations[index];
+    char actual[17];
+    char wanted[17];
+    bool ok;
+
+    if (e->kind == EXPECT_LCD) {
+        lcd_render_row(e->row, actual);
+        trim_right(actual);
+        strcpy(wanted, e->text);
+        trim_right(wanted);
+        ok = strcmp(actual, wanted) == 0;
+        if (!ok) {
+            fprintf(stderr, "%s:%d: at ", scenario_name, e->line);
+            print_time(stderr, now_ns);
+            fprintf(stderr, " lcd row %d is \"%s\", expected \"%s\"\n", e->row, actual, wanted);
+        }
+    } else if (e->kind == EXPECT_BUZZER) {
+        ok = buzzer_on == e->on;
+        if (!ok) {
+            fprintf(stderr, "%s:%d: at ", scenario_name, e->line);
+            print_time(stderr, now_ns);
+            fprintf(stderr, " buzzer is %s, expected %s\n", buzzer_on ? "on" : "off", e->on ? "on" : "off");
+        }
+    } else if (e->kind == EXPECT_BACKLIGHT && e->level >= 0) {
+        double duty = (double)(backlight_on_total() - e->mark_on_ns) / BACKLIGHT_WINDOW_NS;
+        ok = duty * 16 > e->level - 0.5 && duty * 16 < e->level + 0.5; // Within half a level
+        if (!ok) {
+            fprintf(stderr, "%s:%d: at ", scenario_name, e->line);
+            print_time(stderr, now_ns);
+            fprintf(stderr, " backlight duty is %.1f/16 over the last second, expected %d/16\n", duty * 16, e->level);
+        }
+    } else if (e->kind == EXPECT_BACKLIGHT) {
+        bool backlight_on = (pcf_port & PCF_BL_BIT) != 0;
+        ok = backlight_on == e->on;
+        if (!ok) {
+            fprintf(stderr, "%s:%d: at ", scenario_name, e->line);
+            print_time(stderr, now_ns);
+            fprintf(stderr, " backlight is %s, expected %s\n", backlight_on ? "on" : "off", e->on ? "on" : "off");
+        }
+    } else {
+        const tx_frame_t* frame = &last_tx_frame[e->type];
+        int i;
+        ok = frame->seen && frame->time >= e->since && frame->crc_ok &&
+             (e->rest ? frame->length >= e->length : frame->length == e->length);
+        for (i = 0; ok && i < e->length; i++) {
+            ok = e->any[i] || frame->payload[i] == e->bytes[i];
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%d: at ", scenario_name, e->line);
+            print_time(stderr, now_ns);
+            if (!frame->seen || frame->time < e->since) {
+                fprintf(stderr, " no uart frame %02x since ", e->type);
+                print_time(stderr, e->since);
+                fputc('\n', stderr);
+            } else {
+                fprintf(stderr, " uart frame %02x%s is", e->type, frame->crc_ok ? "" : " (bad crc)");
+                for (i = 0; i < frame->length; i++) {
+                    fprintf(stderr, " %02x", frame->payload[i]);
+                }
+                fprintf(stderr, ", expected");
+                for (i = 0; i < e->length; i++) {
+                    if (e->any[i]) {
+                        fprintf(stderr, " ..");
+                    } else {
+                        fprintf(stderr, " %02x", e->bytes[i]);
+                    }
+                }
+                fprintf(stderr, "%s\n", e->rest ? " ..." : "");
+            }
+        }
+    }
+    if (!ok) {
+        expectations_failed++;
+    }
+}
+
+// NEC frame as seen by the receiver (active low): one falling edge per burst
+static void schedule_ir_key(uint64_t t, uint8_t command) {
+    uint8_t bytes[4];
+    int bit;
+    bytes[0] = 0x00;
+    bytes[1] = 0xFF;
+    bytes[2] = command;
+    bytes[3] = (uint8_t)~command;
+    schedule(t, EV_IR_EDGE, 0);                 // Leader burst
+    t += 13500000ULL;                           // 9ms burst + 4.5ms space
+    schedule(t, EV_IR_EDGE, 0);
+    for (bit = 0; bit < 32; bit++) {
+        bool one = (bytes[bit / 8] & (0x80 >> (bit % 8))) != 0;
+        t += one ? 2250000ULL : 1125000ULL;
+        schedule(t, EV_IR_EDGE, 0);
+    }
+}
+
+static bool parse_time(const char* token, uint64_t base, uint64_t* out) {
+    char* unit;
+    double value;
+    double scale = (double)NS_PER_S;
+    bool relative = token[0] == '+';
+
+    value = strtod(relative ? token + 1 : token, &unit);
+    if (unit == token || value < 0) {
+        return false;
+    }
+    if (strcmp(unit, "ms") == 0) {
+        scale = (double)NS_PER_MS;
+    } else if (strcmp(unit, "m") == 0) {
+        scale = 60.0 * NS_PER_S;
+    } else if (strcmp(unit, "h") == 0) {
+        scale = 3600.0 * NS_PER_S;
+    } else if (*unit && strcmp(unit, "s") != 0) {
+        return false;
+    }
+    *out = (relative ? base : 0) + (uint64_t)(value * scale + 0.5);
+    return true;
+}
+
+// '#' starts a comment unless it is inside a quoted LCD text (big digits render as '#')
+static void strip_comment(char* text) {
+    bool quoted = false;
+    for (; *text; text++) {
+        if (*text == '"') {
+            quoted = !quoted;
+        } else if ((*text == '#' && !quoted) || *text == '\r' || *text == '\n') {
+            *text = '\0';
+            return;
+        }
+    }
+}
+
+static void scenario_error(int line, const char* message) {
+    fprintf(stderr, "%s:%d: %s\n", scenario_name, line, message);
+    exit(2);
+}
+
+static void load_scenario(const char* path) {
+    FILE* in = fopen(path, "r");
+    char buffer[MAX_LINE];
+    uint64_t last = 0;
+    uint64_t last_input = 0;            // Time of the last line that wasn't an expectation
+    int line = 0;
+
+    if (!in) {
+        perror(path);
+        exit(2);
+    }
+    scenario_name = path;
+
+    while (fgets(buffer, sizeof(buffer), in)) {
+        char* text = buffer;
+        char* when;
+        char* command;
+        uint64_t t;
+
+        line++;
+        strip_comment(text);
+        when = strtok(text, " \t");
+        if (!when) {
+            continue;
+        }
+        command = strtok(NULL, " \t");
+        if (!command || !parse_time(when, last, &t)) {
+            scenario_error(line, "expected: <time> <command> [args]");
+        }
+        last = t;
+
+        if (strcmp(command, "key") == 0) {
+            const char* name = strtok(NULL, " \t");
+            size_t k;
+            for (k = 0; name && k < sizeof(keys) / sizeof(keys[0]); k++) {
+                if (strcmp(keys[k].name, name) == 0) {
+                    break;
+                }
+            }
+            if (!name || k == sizeof(keys) / sizeof(keys[0])) {
+                scenario_error(line, "unknown key");
+            }
+            schedule_ir_key(t, keys[k].command);
+        } else if (strcmp(command, "button") == 0) {
+            schedule(t, EV_BUTTON_PRESS, 0);
+            schedule(t + BUTTON_HOLD_NS, EV_BUTTON_RELEASE, 0);
+        } else if (strcmp(command, "frame") == 0 || strcmp(command, "uart") == 0) {
+            uint8_t bytes[64];
+            size_t count = 0;
+            size_t i;
+            char* token;
+            bool framed = command[0] == 'f';
+            if (framed) {
+                count = 3; // SYNC, LEN, TYPE filled below
+            }
+            while ((token = strtok(NULL, " \t")) && count < sizeof(bytes) - 1) {
+                bytes[count++] = (uint8_t)strtoul(token, NULL, 16);
+            }
+            if (framed) {
+                if (count < 4) {
+                    scenario_error(line, "frame needs a type");
+                }
+                // The first value given is the type, shift it into place
+                bytes[2] = bytes[3];
+                memmove(&bytes[3], &bytes[4], count - 4);
+                count--;
+                bytes[0] = 0xA5;
+                bytes[1] = (uint8_t)(count - 3);
+                bytes[count] = crc8(&bytes[1], count - 1);
+                count++;
+            }
+            for (i = 0; i < count; i++) {
+                uart_schedule_rx(t, bytes[i]);
+            }
+        } else if (strcmp(command, "i2c-nack") == 0) {
+            const char* count = strtok(NULL, " \t");
+            if (!count || atoi(count) <= 0) {
+                scenario_error(line, "i2c-nack <count>");
+            }
+            schedule(t, EV_I2C_NACK, (uint32_t)atoi(count));
+        } else if (strcmp(command, "expect") == 0) {
+            expectation_t* e;
+            const char* what = strtok(NULL, " \t");
+            if (expectation_count == MAX_EXPECTATIONS) {
+                scenario_error(line, "too many expectations");
+            }
+            e = &expectations[expectation_count];
+            e->line = line;
+            if (what && strcmp(what, "lcd") == 0) {
+                const char* row = strtok(NULL, " \t");
+                char* quoted = strtok(NULL, "\"");
+                e->kind = EXPECT_LCD;
+                e->row = row ? atoi(row) : -1;
+                if (e->row < 0 || e->row > 1) {
+                    scenario_error(line, "expect lcd <0|1> \"text\"");
+                }
+                snprintf(e->text, sizeof(e->text), "%s", quoted ? quoted : "");
+            } else if (what && (strcmp(what, "buzzer") == 0 || strcmp(what, "backlight") == 0)) {
+                const char* state = strtok(NULL, " \t");
+                int level;
+                char slash;
+                e->kind = strcmp(what, "buzzer") == 0 ? EXPECT_BUZZER : EXPECT_BACKLIGHT;
+                e->level = -1;
+                if (e->kind == EXPECT_BACKLIGHT && state && sscanf(state, "%d/16%c", &level, &slash) == 1) {
+                    if (level < 0 || level > 16 || t < BACKLIGHT_WINDOW_NS) {
+                        scenario_error(line, "expect backlight <0..16>/16, at least 1s in");
+                    }
+                    e->level = level;
+                    schedule(t - BACKLIGHT_WINDOW_NS, EV_EXPECT_MARK, (uint32_t)expectation_count);
+                } else if (!state || (strcmp(state, "on") && strcmp(state, "off"))) {
+                    scenario_error(line, "expect buzzer <on|off>, expect backlight <on|off|level/16>");
+                }
+                e->on = state && strcmp(state, "on") == 0;
+            } else if (what && strcmp(what, "uart") == 0) {
+                const char* type = strtok(NULL, " \t");
+                char* token;
+                char* end;
+                e->kind = EXPECT_UART;
+                e->since = last_input;
+                e->length = 0;
+                e->rest = false;
+                if (!type || (e->type = (uint8_t)strtoul(type, &end, 16), *end)) {
+                    scenario_error(line, "expect uart <type> [byte|..]... [...]");
+                }
+                while ((token = strtok(NULL, " \t"))) {
+                    if (e->rest) {
+                        scenario_error(line, "expect uart: \"...\" must come last");
+                    }
+                    if (strcmp(token, "...") == 0) {
+                        e->rest = true;
+                        continue;
+                    }
+                    if (e->length == MAX_FRAME_PAYLOAD) {
+                        scenario_error(line, "uart payload too long");
+                    }
+                    e->any[e->length] = strcmp(token, "..") == 0;
+                    e->bytes[e->length] = (uint8_t)strtoul(token, &end, 16);
+                    if (!e->any[e->length] && *end) {
+                        scenario_error(line, "expect uart: bytes are hex, \"..\" for any");
+                    }
+                    e->length++;
+                }
+            } else {
+                scenario_error(line, "expect lcd|buzzer|backlight|uart ...");
+            }
+            schedule(t, EV_EXPECT, (uint32_t)expectation_count++);
+        } else if (strcmp(command, "end") == 0) {
+            end_ns = t;
+        } else {
+            scenario_error(line, "unknown command");
+        }
+        if (strcmp(command, "expect") != 0) {
+            last_input = t;
+        }
+    }
+    fclose(in);
+}
+
+// ---------------------------------------------------------------------------
+// Event handling and the virtual clock
+
+static double battery_mah = 2000.0;
+static bool cycle_report = false;       // -e
+static uint16_t reported_cycles = 0;
+static uint64_t cycle_truth[ENERGY_CHANNELS]; // Simulator residency when the firmware's cycle began
+static uint64_t cycle_start_ns = 0;
+
+// The simulator's own residency so far, in the firmware's energy channels
+static void residency_now(uint64_t truth[ENERGY_CHANNELS]) {
+    int channel;
+
+    truth[ENERGY_ACTIVE] = active_ns;
+    for (channel = 0; channel < 5; channel++) {
+        truth[ENERGY_LPM0 + channel] = sleep_ns[channel];
+    }
+    truth[ENERGY_I2C_TX] = i2c_busy_ns;
+    truth[ENERGY_BUZZER] = buzzer_on_ns + (buzzer_on ? now_ns - buzzer_since_ns : 0);
+    truth[ENERGY_BACKLIGHT] = backlight_on_total();
+}
+
+// Charge of a residency through the firmware's energy_charge_nah() and current model.
+// Split in equal slices so the 32-bit tick counts can't wrap on long runs.
+static double charge_uah(const uint64_t truth[ENERGY_CHANNELS], uint64_t duration_ns) {
+    uint64_t slices = duration_ns / (24 * 3600 * NS_PER_S) + 1;
+    energy_residency_t residency;
+    int channel;
+
+    residency.duration = (uint32_t)(duration_ns / slices * TIMEBASE_HZ / NS_PER_S);
+    for (channel = 0; channel < ENERGY_CHANNELS; channel++) {
+        residency.ticks[channel] = (uint32_t)(truth[channel] / slices * TIMEBASE_HZ / NS_PER_S);
+    }
+    return energy_charge_nah(&residency, energy_model()) * (double)slices / 1000.0;
+}
+
+// With -e, each cycle the firmware closes is printed next to what the simulator measured
+// over the same span: the firmware can't see interrupt entry and exit outside its hooks
+static void sample_energy_cycle(void) {
+    uint64_t truth[ENERGY_CHANNELS];
+    energy_residency_t residency;
+    uint64_t duration_ns;
+    int channel;
+
+    if (!cycle_report || energy_cycle_count() == reported_cycles) {
+        return;
+    }
+    reported_cycles = energy_cycle_count();
+    residency_now(truth);
+    duration_ns = now_ns - cycle_start_ns;
+    for (channel = 0; channel < ENERGY_CHANNELS; channel++) {
+        uint64_t total = truth[channel];
+        truth[channel] -= cycle_truth[channel];
+        cycle_truth[channel] = total;
+    }
+    cycle_start_ns = now_ns;
+
+    energy_get_cycle(ENERGY_CYCLE_LAST, &residency);
+    printf("cycle %-7u %.1f min: simulator %.1f uAh, active %.2f%% i2c %.2f%%; firmware %.1f uAh, active %.2f%% i2c %.2f%%\n",
+           reported_cycles - 1, duration_ns / (60.0 * NS_PER_S), charge_uah(truth, duration_ns),
+           duration_ns ? 100.0 * truth[ENERGY_ACTIVE] / duration_ns : 0.0,
+           duration_ns ? 100.0 * truth[ENERGY_I2C_TX] / duration_ns : 0.0,
+           energy_charge_nah(&residency, energy_model()) / 1000.0,
+           residency.duration ? 100.0 * residency.ticks[ENERGY_ACTIVE] / residency.duration : 0.0,
+           residency.duration ? 100.0 * residency.ticks[ENERGY_I2C_TX] / residency.duration : 0.0);
+}
+
+// Charge over the whole run from the simulator's own residency
+static void report_energy(void) {
+    static const char* const names[ENERGY_CHANNELS] = {
+        "active", "lpm0", "lpm1", "lpm2", "lpm3", "lpm4", "i2c", "buzzer", "backlight"
+    };
+    uint64_t truth[ENERGY_CHANNELS];
+    energy_residency_t residency;
+    double charge;
+    double average_ua;
+    int channel;
+
+    residency_now(truth);
+    charge = charge_uah(truth, now_ns);
+    average_ua = now_ns ? charge * 3600.0 * NS_PER_S / now_ns : 0.0;
+
+    printf("energy        %.1f uAh, avg %.0f uA, %.1f h on %.0f mAh (",
+           charge, average_ua, average_ua > 0 ? battery_mah * 1000.0 / average_ua : 0.0, battery_mah);
+    for (channel = 0; channel < ENERGY_CHANNELS; channel++) {
+        if (truth[channel]) {
+            printf("%s%s %.2f%%", channel ? " " : "", names[channel], now_ns ? 100.0 * truth[channel] / now_ns : 0.0);
+        }
+    }
+    printf(")\n");
+
+    if (energy_cycle_count() > 1) {
+        energy_get_cycle(ENERGY_CYCLE_LAST, &residency);
+        charge = energy_charge_nah(&residency, energy_model()) / 1000.0;
+        printf("              firmware: last cycle %.1f uAh over %.1f min, avg %.0f uA\n",
+               charge, residency.duration / (60.0 * TIMEBASE_HZ),
+               residency.duration ? charge * 3600.0 * TIMEBASE_HZ / residency.duration : 0.0);
+    }
+}
+
+// Latency and run time as the firmware's own deadline monitor saw them
+static void report_deadlines(void) {
+    deadline_stats_t stats;
+    deadline_fault_t fault;
+    uint16_t budget;
+    uint8_t source;
+    const char* separator = "";
+
+    printf("deadlines    ");
+    for (source = 0; source < DEADLINE_SOURCES; source++) {
+        if (deadline_get_stats(source, &budget, &stats) && budget) {
+            printf("%s %s worst %u/%u us, %u misses", separator, vector_names[source],
+                   stats.worst_latency_us, budget, stats.misses);
+            separator = ";";
+        }
+    }
+    printf("\n");
+
+    deadline_get_fault(&fault);
+    if (fault.source < DEADLINE_SOURCES) {
+        printf("              first miss: %s %u us late at ", vector_names[fault.source], fault.latency_us);
+        print_time(stdout, (uint64_t)fault.at * NS_PER_S / TIMEBASE_HZ);
+        if (fault.blocker < DEADLINE_SOURCES) {
+            printf(" s, blocked by %s (ran %u us)\n", vector_names[fault.blocker], fault.blocker_run_us);
+        } else {
+            printf(" s, interrupts disabled in the main loop\n");
+        }
+    }
+    printf("              longest isr run:");
+    for (source = 0; source < DEADLINE_SOURCES; source++) {
+        deadline_get_stats(source, &budget, &stats);
+        printf(" %s=%u us", vector_names[source], stats.worst_run_us);
+    }
+    printf("\n");
+}
+
+// ---------------------------------------------------------------------------
+// Firmware stack: painted before firmware_main() starts, the untouched tail is the slack
+
+static uint8_t* firmware_stack = NULL;
+static ucontext_t firmware_context;
+static ucontext_t sim_context;
+
+static size_t firmware_stack_peak(void) {
+    size_t untouched = 0;
+    while (untouched < FIRMWARE_STACK_BYTES && firmware_stack[untouched] == STACK_PAINT) {
+        untouched++; // Grows down from the top of the buffer
+    }
+    return FIRMWARE_STACK_BYTES - untouched;
+}
+
+static void run_firmware(void) {
+    firmware_stack = malloc(FIRMWARE_STACK_BYTES);
+    if (!firmware_stack) {
+        perror("firmware stack");
+        exit(2);
+    }
+    memset(firmware_stack, STACK_PAINT, FIRMWARE_STACK_BYTES);
+    getcontext(&firmware_context);
+    firmware_context.uc_stack.ss_sp = firmware_stack;
+    firmware_context.uc_stack.ss_size = FIRMWARE_STACK_BYTES;
+    firmware_context.uc_link = &sim_context; // firmware_main() never returns, but just in case
+    makecontext(&firmware_context, firmware_main, 0);
+    swapcontext(&sim_context, &firmware_context);
+}
+
+static void finish(void) {
+    struct timespec ts;
+    double wall;
+    int v;
+    size_t stack_peak = firmware_stack_peak(); // Before the report itself runs on that stack
+
+    if (buzzer_on) {
+        buzzer_on_ns += now_ns - buzzer_since_ns;
+        buzzer_since_ns = now_ns;
+    }
+    if (pcf_port & PCF_BL_BIT) {
+        backlight_on_ns += now_ns - backlight_since_ns;
+        backlight_since_ns = now_ns;
+    }
+    finishing = true;
+    lcd_flush_pending();
+    if (lcd_trace) fclose(lcd_trace);
+    if (buzzer_trace) fclose(buzzer_trace);
+    if (uart_trace) fclose(uart_trace);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    wall = (double)(ts.tv_sec - run_start.tv_sec) + (ts.tv_nsec - run_start.tv_nsec) / 1e9;
+
+    printf("virtual time  ");
+    print_time(stdout, now_ns);
+    printf(" s in %.2f s wall (x%.0f)\n", wall, wall > 0 ? (now_ns / 1e9) / wall : 0.0);
+    printf("events        %llu\n", (unsigned long long)events_processed);
+    printf("interrupts   ");
+    for (v = 0; v < VEC_COUNT; v++) {
+        printf(" %s=%llu", vector_names[v], (unsigned long long)isr_count[v]);
+    }
+    printf("\n");
+    printf("i2c           %llu transactions, %llu nacks, bus busy %.3f%%\n",
+           (unsigned long long)i2c_transactions, (unsigned long long)i2c_nacks,
+           now_ns ? 100.0 * i2c_busy_ns / now_ns : 0.0);
+    printf("lcd           %llu pcf8574 writes, %llu settled states\n",
+           (unsigned long long)pcf_writes, (unsigned long long)lcd_states);
+    printf("uart          %llu tx bytes, %llu rx bytes, %llu overruns\n",
+           (unsigned long long)uart_tx_bytes, (unsigned long long)uart_rx_bytes,
+           (unsigned long long)uart_rx_overruns);
+    printf("buzzer        %.1f s on, ir edges %llu\n", buzzer_on_ns / 1e9, (unsigned long long)ir_edges);
+    report_energy();
+    report_deadlines();
+    printf("stack         %zu bytes painted (host frames, firmware + ISR dispatch%s)\n",
+           stack_peak, lcd_trace || buzzer_trace || uart_trace ? " + trace output" : "");
+    if (expectation_count) {
+        printf("expectations  %d passed, %d failed\n", expectation_count - expectations_failed, expectations_failed);
+    }
+    fflush(stdout);
+    exit(expectations_failed || watchdog_reset ? 1 : 0);
+}
+
+static void handle_event(const event_t* ev) {
+    events_processed++;
+    switch (ev->type) {
+        case EV_TA0_PERIOD:
+            if (ev->arg == ta0_generation && (TA0CTL & (MC_1 | MC_2))) {
+                TA0CCTL0 |= CCIFG;
+                ta0_period_start_ns = ev->time;
+                schedule(ev->time + ta0_period_ns(), EV_TA0_PERIOD, ta0_generation);
+            }
+            break;
+        case EV_TA2_OVERFLOW:
+            if (ev->arg == ta2_generation && ta2_running()) {
+                TA2CTL |= TAIFG;
+                schedule(ta2_time_of(ta2_ticks_at(ev->time) + 0x10000), EV_TA2_OVERFLOW, ta2_generation);
+            }
+            break;
+        case EV_TA2_COMPARE: {
+            int n = ev->arg & 1;
+            if ((ev->arg >> 1) == ta2_compare_generation[n] && ta2_running()) {
+                volatile uint16_t* cctl = ta2_cctl(n);
+                if (*cctl & CCIFG) {
+                    *cctl |= COV;
+                }
+                *cctl |= CCIFG;
+                schedule(ta2_time_of(ta2_ticks_at(ev->time) + 0x10000), EV_TA2_COMPARE, ev->arg);
+            }
+            break;
+        }
+        case EV_IR_EDGE:
+            ir_edges++;
+            if ((P2SEL & BIT0) && (TA1CTL & (MC_1 | MC_2)) && (TA1CCTL1 & CAP)) {
+                if (TA1CCTL1 & CCIFG) {
+                    TA1CCTL1 |= COV;
+                }
+                TA1CCR1 = ta1_count_at(ev->time); // Captured at the edge, however late the ISR runs
+                TA1CCTL1 |= CCIFG;
+            }
+            break;
+        case EV_BUTTON_PRESS:
+            P1IN &= ~BIT1;
+            if (P1IES & BIT1) {
+                P1IFG |= BIT1;
+            }
+            break;
+        case EV_BUTTON_RELEASE:
+            P1IN |= BIT1;
+            if (!(P1IES & BIT1)) {
+                P1IFG |= BIT1;
+            }
+            break;
+        case EV_UART_RX:
+            uart_rx_bytes++;
+            log_uart_byte(&rx_logger, (uint8_t)ev->arg);
+            if (UCA1CTL1 & UCSWRST) {
+                break;
+            }
+            if (UCA1IFG & UCRXIFG) {
+                uart_rx_overruns++;
+            }
+            UCA1RXBUF = (uint8_t)ev->arg;
+            UCA1IFG |= UCRXIFG;
+            break;
+        case EV_UART_TX_DONE:
+            uart_tx_busy = false;
+            uart_tx_bytes++;
+            log_uart_byte(&tx_logger, sim_reg_UCA1TXBUF);
+            if (pty_fd >= 0) {
+                uint8_t byte = sim_reg_UCA1TXBUF;
+                if (write(pty_fd, &byte, 1) < 0 && errno != EAGAIN) {
+                    perror("pty write");
+                }
+            }
+            UCA1IFG |= UCTXIFG;
+            break;
+        case EV_I2C_DONE:
+            i2c_complete(ev->arg);
+            break;
+        case EV_I2C_NACK:
+            i2c_forced_nacks += ev->arg;
+            break;
+        case EV_WDT_EXPIRE:
+            if (ev->arg == wdt_generation) {
+                if (!watchdog_reset) {
+                    watchdog_reset = "main loop stopped kicking";
+                }
+                fprintf(stderr, "%s: at ", scenario_name ? scenario_name : "sim");
+                print_time(stderr, now_ns);
+                fprintf(stderr, " watchdog reset: %s\n", watchdog_reset);
+                finish();
+            }
+            break;
+        case EV_EXPECT_MARK:
+            expectations[ev->arg].mark_on_ns = backlight_on_total();
+            break;
+        case EV_EXPECT:
+            check_expectation(ev->arg);
+            break;
+        case EV_END:
+            finish();
+            break;
+    }
+}
+
+static int lpm_level(unsigned short bits) {
+    if (bits & OSCOFF) return 4;
+    if ((bits & (SCG1 | SCG0)) == (SCG1 | SCG0)) return 3;
+    if (bits & SCG1) return 2;
+    if (bits & SCG0) return 1;
+    return 0;
+}
+
+// Moves the clock forward, charging the elapsed time to the CPU mode it was spent in
+static void set_now(uint64_t t) {
+    if (t <= now_ns) {
+        return;
+    }
+    if (cpu_asleep && !in_isr) {
+        sleep_ns[lpm_level(sleep_bits)] += t - now_ns;
+    } else {
+        active_ns += t - now_ns;
+    }
+    now_ns = t;
+}
+
+// Runs events up to virtual time t. When called while the CPU sleeps it returns early
+// as soon as an ISR wakes it, so input arriving in real time is handled right away.
+static void advance_to(uint64_t t) {
+    bool sleeping = cpu_asleep;
+    if (finishing) {
+        return;
+    }
+    for (;;) {
+        bool due;
+        if (sleeping && !cpu_asleep) {
+            return;
+        }
+        sample();
+        due = heap_count && heap[0].time <= t;
+        if (realtime && pace_until(due ? heap[0].time : t)) {
+            continue;
+        }
+        if (!due) {
+            break;
+        }
+        {
+            event_t ev = pop_event();
+            set_now(ev.time);
+            handle_event(&ev);
+        }
+        sample();
+        dispatch_pending();
+    }
+    set_now(t);
+    sample();
+}
+
+// ---------------------------------------------------------------------------
+// Intrinsics used by the firmware
+
+void sim_delay_cycles(unsigned long cycles) {
+    advance_to(now_ns + (uint64_t)cycles * NS_PER_S / MCLK_HZ);
+}
+
+void sim_set_interrupt_state(unsigned short state) {
+    gie = (state & GIE) != 0;
+    dispatch_pending();
+}
+
+unsigned short sim_get_interrupt_state(void) {
+    return gie ? GIE : 0;
+}
+
+void sim_bis_sr(unsigned short bits) {
+    if (bits & GIE) {
+        gie = true;
+    }
+    if (!(bits & CPUOFF)) {
+        dispatch_pending();
+        return;
+    }
+    // Low-power mode: nothing runs until an ISR clears CPUOFF on exit
+    sleep_bits = bits;
+    cpu_asleep = true;
+    while (cpu_asleep) {
+        dispatch_pending();
+        if (!cpu_asleep) {
+            break;
+        }
+        if (heap_count) {
+            advance_to(heap[0].time);
+        } else if (pty_fd >= 0) {
+            pace_until(UINT64_MAX);
+        } else {
+            fprintf(stderr, "sim: CPU asleep with nothing left to wake it\n");
+            finish();
+        }
+    }
+    advance_to(now_ns + WAKE_CYCLES * NS_PER_S / MCLK_HZ);
+}
+
+void sim_bic_sr_on_exit(unsigned short bits) {
+    if (in_isr && (bits & CPUOFF)) {
+        wake_on_exit = true;
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-l lcd.trace] [-b buzzer.trace] [-u uart.trace] [-t duration] [-r] [-p] [-c mAh] [-e] [scenario]\n"
+            "  -l  LCD contents timeline\n"
+            "  -b  buzzer on/off trace\n"
+            "  -u  UART frames in both directions\n"
+            "  -t  stop after this virtual time (e.g. 90m, 24h), overrides 'end'\n"
+            "  -r  run in real time instead of as fast as possible\n"
+            "  -p  expose USCI_A1 as a pseudo-terminal (implies -r)\n"
+            "  -c  battery capacity for the battery-life projection (default 2000 mAh)\n"
+            "  -e  print each energy cycle the firmware closes, next to the simulator's measurement\n",
+            argv0);
+    exit(2);
+}
+
+static FILE* open_trace(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        exit(2);
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    const char* duration = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:b:u:t:c:erph")) != -1) {
+        switch (opt) {
+            case 'l': lcd_trace = open_trace(optarg); break;
+            case 'b': buzzer_trace = open_trace(optarg); break;
+            case 'u': uart_trace = open_trace(optarg); break;
+            case 't': duration = optarg; break;
+            case 'r': realtime = true; break;
+            case 'c': battery_mah = atof(optarg); break;
+            case 'e': cycle_report = true; break;
+            case 'p': realtime = true; open_pty(); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind < argc) {
+        load_scenario(argv[optind]);
+    }
+    if (duration && !parse_time(duration, 0, &end_ns)) {
+        usage(argv[0]);
+    }
+    if (end_ns == UINT64_MAX && pty_fd < 0) {
+        fprintf(stderr, "sim: no end time, give -t or an 'end' line in the scenario\n");
+        return 2;
+    }
+    if (end_ns != UINT64_MAX) {
+        schedule(end_ns, EV_END, 0);
+    }
+
+    // Power-on register state
+    P1IN = 0xFF;
+    P2IN = 0xFF;
+    UCA1CTL1 = UCSWRST;
+    UCA1IFG = UCTXIFG;
+    sim_reg_UCB0CTL1 = UCSWRST;
+    memset(lcd_ddram, ' ', sizeof(lcd_ddram));
+
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    wall_start = run_start;
+
+    run_firmware();
+    finish();
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "timebase.h"
+#include "energy.h"
+#include "deadline.h"
+
+static volatile uint16_t overflow_count = 0;
+static volatile timebase_alarm_t alarm_callbacks[TIMEBASE_ALARMS];
+
+void configure_timebase(void) {
+    TA2CCTL1 = 0;
+    TA2CCTL2 = 0;
+    TA2CTL = TASSEL_1 | MC_2 | TACLR | TAIE; // ACLK, continuous mode, overflow interrupt
+}
+
+static uint16_t read_counter(void) {
+    uint16_t first, second;
+    do {                                    // TA2 runs from ACLK, asynchronous to MCLK:
+        first = TA2R;                       // read until two samples agree
+        second = TA2R;
+    } while (first != second);
+    return second;
+}
+
+uint32_t timebase_now(void) {
+    uint16_t high, low;
+    unsigned short interrupt_state = __get_interrupt_state();
+
+    __disable_interrupt();
+    low = read_counter();
+    high = overflow_count;
+    if ((TA2CTL & TAIFG) && low < 0x8000) {
+        high++;                             // Wrapped, but the overflow hasn't been counted yet
+    }
+    __set_interrupt_state(interrupt_state);
+
+    return ((uint32_t)high << 16) | low;
+}
+
+void timebase_set_alarm(uint8_t alarm, uint16_t delay_ticks, timebase_alarm_t callback) {
+    unsigned short interrupt_state = __get_interrupt_state();
+    uint16_t at;
+
+    if (delay_ticks == 0) {
+        delay_ticks = 1;
+    }
+    __disable_interrupt();
+    alarm_callbacks[alarm] = callback;
+    at = read_counter() + delay_ticks;
+    if (alarm == TIMEBASE_ALARM_I2C_BACKOFF) {
+        TA2CCR1 = at;
+        TA2CCTL1 = CCIE;                    // Also clears a stale CCIFG
+    } else {
+        TA2CCR2 = at;
+        TA2CCTL2 = CCIE;
+    }
+    __set_interrupt_state(interrupt_state);
+}
+
+void timebase_cancel_alarm(uint8_t alarm) {
+    unsigned short interrupt_state = __get_interrupt_state();
+
+    __disable_interrupt();
+    if (alarm == TIMEBASE_ALARM_I2C_BACKOFF) {
+        TA2CCTL1 = 0;
+    } else {
+        TA2CCTL2 = 0;
+    }
+    alarm_callbacks[alarm] = 0;
+    __set_interrupt_state(interrupt_state);
+}
+
+static void run_alarm(uint8_t alarm) {
+    timebase_alarm_t callback = alarm_callbacks[alarm];
+    if (alarm == TIMEBASE_ALARM_I2C_BACKOFF) {
+        TA2CCTL1 = 0;                       // One-shot
+    } else {
+        TA2CCTL2 = 0;
+    }
+    alarm_callbacks[alarm] = 0;
+    if (callback) {
+        callback();
+    }
+}
+
+void timebase_poll(void) {
+    if ((TA2CCTL1 & CCIE) && (TA2CCTL1 & CCIFG)) {
+        run_alarm(TIMEBASE_ALARM_I2C_BACKOFF);
+    }
+    if ((TA2CCTL2 & CCIE) && (TA2CCTL2 & CCIFG)) {
+        run_alarm(TIMEBASE_ALARM_BACKLIGHT);
+    }
+    if (TA2CTL & TAIFG) {
+        TA2CTL &= ~TAIFG;
+        overflow_count++;
+    }
+}
+
+#pragma vector=TIMER2_A1_VECTOR
+__interrupt void TIMER2_A1_ISR(void) {
+    uint32_t now;
+
+    now = timebase_now();                   // Before TA2IV clears a pending TAIFG
+    energy_isr_enter(now);
+    deadline_isr_enter(DEADLINE_TIMER2_A1, now);
+    switch (__even_in_range(TA2IV, TA2IV_TAIFG)) {
+        case TA2IV_TACCR1:
+            deadline_check(DEADLINE_ACLK_US(read_counter() - TA2CCR1));
+            run_alarm(TIMEBASE_ALARM_I2C_BACKOFF);
+            break;
+        case TA2IV_TACCR2:
+            deadline_check(DEADLINE_ACLK_US(read_counter() - TA2CCR2));
+            run_alarm(TIMEBASE_ALARM_BACKLIGHT);
+            break;
+        case TA2IV_TAIFG:
+            deadline_check(DEADLINE_ACLK_US(read_counter())); // Wrapped to 0 at the overflow
+            overflow_count++;
+            break;
+    }
+    now = timebase_now();
+    deadline_isr_exit(now);
+    energy_isr_exit(now);
+}
@@ -0,0 +1,26 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <msp430.h>
+#include <stdint.h>
+
+// Free-running time base on Timer2_A: ACLK (32768Hz) in continuous mode, extended
+// to 32 bits by counting overflows. CCR1 and CCR2 provide one-shot alarms.
+
+#define TIMEBASE_HZ         32768UL
+#define TIMEBASE_MS(ms)     ((uint32_t)(ms) * TIMEBASE_HZ / 1000)
+
+// Alarm owners
+#define TIMEBASE_ALARM_I2C_BACKOFF  0   // TA2CCR1
+#define TIMEBASE_ALARM_BACKLIGHT    1   // TA2CCR2
+#define TIMEBASE_ALARMS             2
+
+typedef void (*timebase_alarm_t)(void);
+
+void configure_timebase(void);
+uint32_t timebase_now(void);
+void timebase_set_alarm(uint8_t alarm, uint16_t delay_ticks, timebase_alarm_t callback); // Callback runs in interrupt context
+void timebase_cancel_alarm(uint8_t alarm);
+void timebase_poll(void); // Services alarm/overflow flags when interrupts are disabled
+
+#endif
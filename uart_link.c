@@ -0,0 +1,187 @@
+#include "uart_link.h"
+#include "timebase.h"
+#include "energy.h"
+#include "deadline.h"
+
+#define TX_MASK (LINK_TX_BUFFER_SIZE - 1)
+#define RX_MASK (LINK_RX_BUFFER_SIZE - 1)
+
+// Receive parser states
+#define PARSE_SYNC      0
+#define PARSE_LENGTH    1
+#define PARSE_TYPE      2
+#define PARSE_PAYLOAD   3
+#define PARSE_CRC       4
+
+static volatile uint8_t tx_buffer[LINK_TX_BUFFER_SIZE];
+static volatile uint8_t tx_head = 0; // Written by senders
+static volatile uint8_t tx_tail = 0; // Written by the TX interrupt
+
+static volatile uint8_t rx_buffer[LINK_RX_BUFFER_SIZE];
+static volatile uint8_t rx_head = 0; // Written by the RX interrupt
+static volatile uint8_t rx_tail = 0; // Written by uart_link_receive()
+
+static volatile link_stats_t link_stats;
+
+static uint8_t parse_state = PARSE_SYNC;
+static uint8_t parse_index = 0;
+static uint8_t parse_crc = 0;
+static link_frame_t parse_frame;
+
+static uint8_t crc8_update(uint8_t crc, uint8_t data) {
+    uint8_t bit;
+    crc ^= data;
+    for (bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+void configure_uart_link(void) {
+    P4SEL |= BIT4 | BIT5;                     // P4.4 = UCA1TXD, P4.5 = UCA1RXD
+    UCA1CTL1 |= UCSWRST;                      // Enable SW reset
+    UCA1CTL0 = 0;                             // 8N1, LSB first, UART mode
+    UCA1CTL1 = UCSSEL_2 | UCSWRST;            // Use SMCLK, keep SW reset
+    UCA1BR0 = 109;                            // 1048576Hz / 9600 = 109.2
+    UCA1BR1 = 0;
+    UCA1MCTL = UCBRS_2 | UCBRF_0;             // Modulation for the .2 fraction
+    UCA1CTL1 &= ~UCSWRST;                     // Clear SW reset, resume operation
+    UCA1IE |= UCRXIE;                         // TX interrupt is only enabled while there is data
+}
+
+// Queues a whole frame or nothing; safe to call from both the main loop and ISRs
+bool uart_link_send(uint8_t type, const uint8_t* payload, uint8_t length) {
+    uint8_t crc = 0;
+    uint8_t free_space;
+    uint8_t i;
+    unsigned short interrupt_state;
+
+    if (length > LINK_MAX_PAYLOAD) {
+        return false;
+    }
+
+    interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+
+    free_space = (uint8_t)(LINK_TX_BUFFER_SIZE - (uint8_t)(tx_head - tx_tail)); // Indices run free, masked on access
+    if (free_space < length + LINK_FRAME_OVERHEAD) {
+        link_stats.tx_overflows++;
+        __set_interrupt_state(interrupt_state);
+        return false;
+    }
+
+    tx_buffer[tx_head++ & TX_MASK] = LINK_SYNC_BYTE;
+    tx_buffer[tx_head++ & TX_MASK] = length;
+    crc = crc8_update(crc, length);
+    tx_buffer[tx_head++ & TX_MASK] = type;
+    crc = crc8_update(crc, type);
+    for (i = 0; i < length; i++) {
+        tx_buffer[tx_head++ & TX_MASK] = payload[i];
+        crc = crc8_update(crc, payload[i]);
+    }
+    tx_buffer[tx_head++ & TX_MASK] = crc;
+    link_stats.frames_tx++;
+
+    if (!(UCA1IE & UCTXIE)) {
+        // Idle: TXBUF is empty, but reading UCA1IV cleared the TXIFG that said so, and enabling
+        // TXIE alone would never interrupt. Raising the flag again kicks off the transfer.
+        UCA1IFG |= UCTXIFG;
+        UCA1IE |= UCTXIE;
+    }
+
+    __set_interrupt_state(interrupt_state);
+    return true;
+}
+
+// Drains the RX ring through the frame parser; returns true once a frame with a valid CRC is complete
+bool uart_link_receive(link_frame_t* frame) {
+    uint8_t data;
+
+    while (rx_tail != rx_head) {
+        data = rx_buffer[rx_tail & RX_MASK];
+        rx_tail++;
+
+        switch (parse_state) {
+            case PARSE_SYNC:
+                if (data == LINK_SYNC_BYTE) {
+                    parse_state = PARSE_LENGTH;
+                }
+                break;
+            case PARSE_LENGTH:
+                if (data > LINK_MAX_PAYLOAD) {
+                    link_stats.frame_errors++;
+                    parse_state = PARSE_SYNC;
+                    break;
+                }
+                parse_frame.length = data;
+                parse_crc = crc8_update(0, data);
+                parse_state = PARSE_TYPE;
+                break;
+            case PARSE_TYPE:
+                parse_frame.type = data;
+                parse_crc = crc8_update(parse_crc, data);
+                parse_index = 0;
+                parse_state = (parse_frame.length > 0) ? PARSE_PAYLOAD : PARSE_CRC;
+                break;
+            case PARSE_PAYLOAD:
+                parse_frame.payload[parse_index++] = data;
+                parse_crc = crc8_update(parse_crc, data);
+                if (parse_index >= parse_frame.length) {
+                    parse_state = PARSE_CRC;
+                }
+                break;
+            case PARSE_CRC:
+                parse_state = PARSE_SYNC;
+                if (data != parse_crc) {
+                    link_stats.frame_errors++;
+                    break;
+                }
+                link_stats.frames_rx++;
+                *frame = parse_frame;
+                return true;
+        }
+    }
+    return false;
+}
+
+bool uart_link_rx_pending(void) {
+    return rx_tail != rx_head;
+}
+
+const volatile link_stats_t* uart_link_stats(void) {
+    return &link_stats;
+}
+
+// UART interrupt: only moves bytes between the ring buffers and the hardware
+#pragma vector=USCI_A1_VECTOR
+__interrupt void USCI_A1_ISR(void) {
+    uint8_t data;
+    uint32_t now;
+
+    now = timebase_now();
+    energy_isr_enter(now);
+    deadline_isr_enter(DEADLINE_USCI_A1, now);
+    switch (__even_in_range(UCA1IV, 4)) {
+        case 2: // UCRXIFG
+            data = UCA1RXBUF;
+            if ((uint8_t)(rx_head - rx_tail) >= LINK_RX_BUFFER_SIZE) {
+                link_stats.rx_overflows++;
+            } else {
+                rx_buffer[rx_head & RX_MASK] = data;
+                rx_head++;
+                __bic_SR_register_on_exit(LPM0_bits); // Let the main loop parse it
+            }
+            break;
+        case 4: // UCTXIFG
+            if (tx_tail != tx_head) {
+                UCA1TXBUF = tx_buffer[tx_tail & TX_MASK];
+                tx_tail++;
+            } else {
+                UCA1IE &= ~UCTXIE; // Nothing left, stop until the next frame
+            }
+            break;
+    }
+    now = timebase_now();
+    deadline_isr_exit(now);
+    energy_isr_exit(now);
+}
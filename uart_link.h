@@ -0,0 +1,72 @@
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Backchannel UART on USCI_A1: TXD -> P4.4 / RXD -> P4.5, 9600 8N1 from SMCLK ~1.048MHz
+//
+// Frame: SYNC | LEN | TYPE | PAYLOAD[LEN] | CRC
+// CRC is CRC-8 (poly 0x07, init 0x00) over LEN, TYPE and PAYLOAD.
+// Multi-byte fields in payloads are little-endian.
+
+#define LINK_SYNC_BYTE          0xA5
+#define LINK_MAX_PAYLOAD        32
+#define LINK_FRAME_OVERHEAD     4   // SYNC + LEN + TYPE + CRC
+
+#define LINK_TX_BUFFER_SIZE     128 // Must be a power of two; holds a few full-size replies
+#define LINK_RX_BUFFER_SIZE     32  // Must be a power of two
+
+// Device -> host
+#define LINK_MSG_TICK           0x01 // [timer type, minutes, seconds]
+#define LINK_MSG_SESSION        0x02 // [event, step, timer type]
+#define LINK_MSG_COUNTERS       0x03 // [ticks u32, ir frames u16, lcd i2c writes u32, link_stats_t fields u16 x5]
+#define LINK_MSG_BUS_STATS      0x04 // [device, address, bus busy u32, bus elapsed u32 (timebase ticks, whole
+                                     //  bus, cumulative), transactions u32, nacks u16, failures u16,
+                                     //  avg latency u16, max latency u16]
+#define LINK_MSG_ENERGY         0x05 // [which, cycle number u16, duration u32 (timebase ticks), charge uAh u32,
+                                     //  residency u16 x ENERGY_CHANNELS as a fraction of the duration / 65536]
+#define LINK_MSG_DEADLINES      0x06 // [ISR, budget us u16, entries u32, misses u16, worst latency us u16, worst run us u16]
+#define LINK_MSG_FAULT          0x07 // [late ISR, blocker, latency us u16, budget us u16, blocker run us u16,
+                                     //  at u32 (timebase ticks), boot u16, boots u16, watchdog resets u16]
+#define LINK_MSG_ACK            0x7E // [acknowledged type]
+#define LINK_MSG_NACK           0x7F // [rejected type]
+
+// Host -> device
+#define LINK_CMD_KEY            0x10 // [NEC command byte], handled like a received IR frame
+#define LINK_CMD_SET_TIMES      0x11 // [focus minutes, rest minutes], each 1..99
+#define LINK_CMD_GET_COUNTERS   0x12 // []
+#define LINK_CMD_GET_BUS_STATS  0x13 // [I2C device index]; latencies in timebase ticks
+#define LINK_CMD_GET_ENERGY     0x14 // [ENERGY_CYCLE_LAST or ENERGY_CYCLE_CURRENT]
+#define LINK_CMD_SET_CURRENT    0x15 // [energy model channel, uA u16]
+#define LINK_CMD_SET_BACKLIGHT  0x16 // [preset profile] or [active level, idle level, idle timeout s]
+#define LINK_CMD_GET_DEADLINES  0x17 // [ISR, DEADLINE_* index]
+#define LINK_CMD_GET_FAULT      0x18 // [] or [1] to also clear the captured miss
+
+// LINK_MSG_SESSION events
+#define LINK_SESSION_STEP       0x00 // currentStep changed
+#define LINK_SESSION_PHASE      0x01 // A focus/rest countdown started
+#define LINK_SESSION_RESET      0x02 // Reset button pressed
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+} link_frame_t;
+
+typedef struct {
+    uint16_t frames_rx;
+    uint16_t frames_tx;
+    uint16_t frame_errors;  // Bad CRC or length
+    uint16_t rx_overflows;  // Bytes dropped because the RX ring was full
+    uint16_t tx_overflows;  // Frames dropped because the TX ring was full
+} link_stats_t;
+
+void configure_uart_link(void);
+bool uart_link_send(uint8_t type, const uint8_t* payload, uint8_t length);
+bool uart_link_receive(link_frame_t* frame);
+bool uart_link_rx_pending(void);
+const volatile link_stats_t* uart_link_stats(void);
+
+#endif